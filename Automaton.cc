@@ -2,14 +2,18 @@
 #include <algorithm>
 #include <array>
 #include <assert.h>
+#include <atomic>
 #include <cstddef>
 #include <cstdlib>
+#include <iterator>
 #include <vector>
 #include <ctype.h>
 #include <map>
 #include <ostream>
 #include <set>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <cctype>
@@ -20,79 +24,215 @@
 
 namespace fa {
 
-  Automaton::Automaton() {}
+  Automaton::Automaton()
+  : d(std::make_shared<Data>())
+  {}
+
+  Automaton::Automaton(Automaton&& other) noexcept
+  : d(std::move(other.d))
+  {
+    other.d = emptyData();
+  }
+
+  Automaton& Automaton::operator=(Automaton&& other) noexcept {
+    if(this != &other){
+      d = std::move(other.d);
+      other.d = emptyData();
+    }
+    return *this;
+  }
+
+  const std::shared_ptr<Automaton::Data>& Automaton::emptyData() {
+    static const std::shared_ptr<Data> empty = std::make_shared<Data>();
+    return empty;
+  }
+
+  Automaton::Data& Automaton::mut() {
+    if(d.use_count() > 1){
+      d = std::make_shared<Data>(*d);
+    }
+    return *d;
+  }
 
   /***************************** */
   /*            MISC             */
   /***************************** */
 
-  std::set<char> Automaton::getAl() const {
-    return al;
+  const SymbolSet& Automaton::getAl() const {
+    return d->al;
+  }
+
+  const std::set<int>& Automaton::getSt() const {
+    return d->states;
   }
 
-  std::set<int> Automaton::getSt() const {
-    return states;
+  const std::set<int>& Automaton::getInitialSt() const {
+    return d->initial_states;
   }
 
-  std::set<int> Automaton::getInitialSt() const {
-    return initial_states;
+  const std::set<int>& Automaton::getFinalSt() const {
+    return d->final_states;
   }
 
-  std::set<int> Automaton::getFinalSt() const {
-    return final_states;
+  const std::map<std::pair<int, char>, std::set<int>>& Automaton::getTr() const {
+    return d->tr;
   }
 
-  std::map<std::pair<int, char>, std::set<int>> Automaton::getTr() const {
-    return tr;
+  void Automaton::setAl(const std::set<char>& _al){
+    mut().al = _al;
   }
 
-  void Automaton::setAl(std::set<char> _al){
-    al = _al;
+  void Automaton::setAl(const SymbolSet& _al){
+    mut().al = _al;
   }
 
-  void Automaton::setSt(std::set<int> _st){
-    states = _st;
+  void Automaton::setSt(const std::set<int>& _st){
+    mut().states = _st;
   }
 
-  void Automaton::setInitSt(std::set<int> _init_st){
-    initial_states = _init_st;
+  void Automaton::setInitSt(const std::set<int>& _init_st){
+    mut().initial_states = _init_st;
   }
 
-  void Automaton::setFinalSt(std::set<int> _final_st){
-    final_states = _final_st;
+  void Automaton::setFinalSt(const std::set<int>& _final_st){
+    mut().final_states = _final_st;
   }
 
-  void Automaton::setTr(std::map<std::pair<int, char>, std::set<int>> _tr){
-    tr = _tr;
+  void Automaton::setTr(const std::map<std::pair<int, char>, std::set<int>>& _tr){
+    Data& data = mut();
+    data.tr = _tr;
+    if(data.predecessor_index) buildPredecessorIndex();
   }
 
   void Automaton::removeFinalState(int state){
     assert(&state != NULL);
     if(isStateFinal(state)){
-      final_states.erase(state);
+      mut().final_states.erase(state);
     }
   }
 
   void Automaton::removeInitialState(int state){
     if(isStateInitial(state)){
-      initial_states.erase(state);
+      mut().initial_states.erase(state);
     }
   }
 
   void Automaton::copy(const Automaton& other){
-    setAl(other.getAl());
-    setSt(other.getSt());
-    setFinalSt(other.getFinalSt());
-    setInitSt(other.getInitialSt());
-    setTr(other.getTr());
+    // Shared until one of them changes
+    d = other.d;
+  }
+
+  void Automaton::setPredecessorIndex(bool enabled) {
+    Data& data = mut();
+    data.predecessor_index = enabled;
+    if(enabled) buildPredecessorIndex();
+    else data.rtr.clear();
+  }
+
+  bool Automaton::hasPredecessorIndex() const {
+    return d->predecessor_index;
+  }
+
+  void Automaton::buildPredecessorIndex() {
+    Data& data = mut();
+    data.rtr.clear();
+    for(const auto& t : data.tr){
+      for(auto to : t.second){
+        data.rtr[{to, t.first.second}].insert(t.first.first);
+      }
+    }
+  }
+
+  bool Automaton::unlink(std::map<std::pair<int, char>, std::set<int>>& transitions,
+                         std::pair<int, char> key, int state) {
+    auto find = transitions.find(key);
+    if(find == transitions.end() || find->second.erase(state) == 0) return false;
+    if(find->second.empty()) transitions.erase(find);
+    return true;
+  }
+
+  void Automaton::keepStates(const std::set<int>& kept) {
+    // Nothing to remove, leave shared data alone
+    if(kept.size() == d->states.size() && std::includes(kept.begin(), kept.end(), d->states.begin(), d->states.end())){
+      return;
+    }
+    Data& data = mut();
+    auto isKept = [&kept](int st){ return kept.find(st) != kept.end(); };
+
+    for(auto it = data.states.begin(); it != data.states.end();){
+      if(isKept(*it)) ++it;
+      else it = data.states.erase(it);
+    }
+    for(auto it = data.initial_states.begin(); it != data.initial_states.end();){
+      if(isKept(*it)) ++it;
+      else it = data.initial_states.erase(it);
+    }
+    for(auto it = data.final_states.begin(); it != data.final_states.end();){
+      if(isKept(*it)) ++it;
+      else it = data.final_states.erase(it);
+    }
+    for(auto it = data.tr.begin(); it != data.tr.end();){
+      if(!isKept(it->first.first)){
+        it = data.tr.erase(it);
+        continue;
+      }
+      for(auto to = it->second.begin(); to != it->second.end();){
+        if(isKept(*to)) ++to;
+        else to = it->second.erase(to);
+      }
+      if(it->second.empty()) it = data.tr.erase(it);
+      else ++it;
+    }
+    if(data.predecessor_index) buildPredecessorIndex();
   }
 
   /***************************** */
   /*            MAIN             */
   /***************************** */
 
+  void Automaton::compact() {
+    Data& data = mut();
+    const StateIndex index(data.states);
+
+    std::set<int> compact_states;
+    for(std::size_t st = 0; st < index.size(); ++st){
+      compact_states.insert(compact_states.end(), static_cast<int>(st));
+    }
+
+    std::set<int> compact_initial;
+    for(auto st : data.initial_states){
+      compact_initial.insert(compact_initial.end(), index.indexOf(st));
+    }
+
+    std::set<int> compact_final;
+    for(auto st : data.final_states){
+      compact_final.insert(compact_final.end(), index.indexOf(st));
+    }
+
+    // Renumbering keeps the order, so keys and targets stay sorted
+    std::map<std::pair<int, char>, std::set<int>> compact_tr;
+    for(const auto& t : data.tr){
+      int from = index.indexOf(t.first.first);
+      if(from < 0) continue;
+      std::set<int> to;
+      for(auto st : t.second){
+        int st_index = index.indexOf(st);
+        if(st_index >= 0) to.insert(to.end(), st_index);
+      }
+      if(!to.empty()){
+        compact_tr.emplace_hint(compact_tr.end(), std::make_pair(from, t.first.second), std::move(to));
+      }
+    }
+
+    data.states = std::move(compact_states);
+    data.initial_states = std::move(compact_initial);
+    data.final_states = std::move(compact_final);
+    data.tr = std::move(compact_tr);
+    if(data.predecessor_index) buildPredecessorIndex();
+  }
+
   bool Automaton::isValid() const {
-    if(al.empty() || states.empty()){
+    if(d->al.empty() || d->states.empty()){
       return false;
     }
     return true;
@@ -106,7 +246,7 @@ namespace fa {
     if(hasSymbol(symbol)){
       return false;
     }
-    al.insert(symbol);
+    mut().al.insert(symbol);
     if(hasSymbol(symbol)){
       return true;
     }
@@ -116,9 +256,14 @@ namespace fa {
   bool Automaton::removeSymbol(char symbol) {
     assert(&symbol != NULL);
     if(hasSymbol(symbol)){
-      al.erase(symbol);
-      for (auto it = tr.begin(); it != tr.end();){
-        if(it->first.second == symbol) it = tr.erase(it);
+      Data& data = mut();
+      data.al.erase(symbol);
+      for (auto it = data.tr.begin(); it != data.tr.end();){
+        if(it->first.second == symbol) it = data.tr.erase(it);
+        else ++it;
+      }
+      for (auto it = data.rtr.begin(); it != data.rtr.end();){
+        if(it->first.second == symbol) it = data.rtr.erase(it);
         else ++it;
       }
       return true;
@@ -128,14 +273,11 @@ namespace fa {
 
   bool Automaton::hasSymbol(char symbol) const {
     assert(&symbol != NULL);
-    if(al.find(symbol) != al.end()){
-      return true;
-    }
-    return false;
+    return d->al.contains(symbol);
   }
 
   std::size_t Automaton::countSymbols() const {
-    return al.size();
+    return d->al.size();
   }
 
   bool Automaton::addState(int state) {
@@ -143,7 +285,7 @@ namespace fa {
     if(hasState(state) || state < 0){
       return false;
     }
-    states.insert(state);
+    mut().states.insert(state);
     if(hasState(state)){
       return true;
     }
@@ -153,16 +295,38 @@ namespace fa {
   bool Automaton::removeState(int state) {
     assert(&state != NULL);
     if(hasState(state)){
-      if(states.erase(state) != 1){
+      Data& data = mut();
+      if(data.states.erase(state) != 1){
         return false;
       }
 
-      // Remove transitions in which the state is implied
-      for(auto symbol : getAl()){
-        removeTransition(state, symbol, state);
-        for(auto s : getSt()){
-          removeTransition(s, symbol, state);
-          removeTransition(state, symbol, s);
+      // Remove transitions leaving the state, they are contiguous in the map
+      const std::pair<int, char> first_key(state, std::numeric_limits<char>::min());
+      auto first = data.tr.lower_bound(first_key);
+      auto last = first;
+      for(; last != data.tr.end() && last->first.first == state; ++last){
+        if(!data.predecessor_index) continue;
+        for(auto to : last->second){
+          unlink(data.rtr, {to, last->first.second}, state);
+        }
+      }
+      data.tr.erase(first, last);
+
+      // Remove transitions reaching the state
+      if(data.predecessor_index){
+        first = data.rtr.lower_bound(first_key);
+        last = first;
+        for(; last != data.rtr.end() && last->first.first == state; ++last){
+          for(auto from : last->second){
+            unlink(data.tr, {from, last->first.second}, state);
+          }
+        }
+        data.rtr.erase(first, last);
+      }else{
+        for(auto it = data.tr.begin(); it != data.tr.end();){
+          it->second.erase(state);
+          if(it->second.empty()) it = data.tr.erase(it);
+          else ++it;
         }
       }
 
@@ -177,39 +341,39 @@ namespace fa {
 
   bool Automaton::hasState(int state) const {
     assert(&state != NULL);
-    if(states.count(state) != 0){
+    if(d->states.count(state) != 0){
       return true;
     }
     return false;
   }
 
   std::size_t Automaton::countStates() const {
-    return states.size();
+    return d->states.size();
   }
 
   void Automaton::setStateInitial(int state) {
     assert(&state != NULL);
     // Test error "ReadEmptyString"
     if(hasState(state)){
-      initial_states.insert(state);
+      mut().initial_states.insert(state);
     }
   }
 
   bool Automaton::isStateInitial(int state) const{
     assert(&state != NULL);
-    return (initial_states.count(state) != 0);
+    return (d->initial_states.count(state) != 0);
   }
 
   void Automaton::setStateFinal(int state) {
     assert(&state != NULL);
     if(hasState(state)){
-      final_states.insert(state);
+      mut().final_states.insert(state);
     }
   }
 
   bool Automaton::isStateFinal(int state) const{
     assert(&state != NULL);
-    return (final_states.count(state) != 0);
+    return (d->final_states.count(state) != 0);
   }
 
   bool Automaton::addTransition(int from, char alpha, int to) {
@@ -224,7 +388,9 @@ namespace fa {
       return false;
     }
 
-    return tr[{from, alpha}].insert(to).second;
+    Data& data = mut();
+    if(data.predecessor_index) data.rtr[{to, alpha}].insert(from);
+    return data.tr[{from, alpha}].insert(to).second;
   }
 
   bool Automaton::removeTransition(int from, char alpha, int to) {
@@ -235,11 +401,10 @@ namespace fa {
       // transition does not exist
       return false;
     }
-    auto key = std::pair(from, alpha);
-    if(tr.count(key) != 0){
-      // transition found
-      tr.erase(key);
-    }
+    Data& data = mut();
+    // Only this target is removed, the other ones of (from, alpha) stay
+    unlink(data.tr, {from, alpha}, to);
+    if(data.predecessor_index) unlink(data.rtr, {to, alpha}, from);
     //  
     return !hasTransition(from, alpha, to);
   }
@@ -248,36 +413,33 @@ namespace fa {
     assert(&from != NULL);
     assert(&to != NULL);
     assert(&alpha != NULL);
-    auto find = tr.find({from, alpha});
-    if(find != tr.end() && find->second.count(to) != 0) return true;
+    auto find = d->tr.find({from, alpha});
+    if(find != d->tr.end() && find->second.count(to) != 0) return true;
     return false;
   }
 
   std::size_t Automaton::countTransitions() const {
     std::size_t res = 0;
-    for(auto from : getSt()){
-      for(auto symbol : getAl()){
-        auto findKey = tr.find(std::make_pair(from, symbol)); 
-        if(findKey != tr.end()) res += findKey->second.size();
-      }
-      auto findKey = tr.find(std::make_pair(from, fa::Epsilon)); 
-        if(findKey != tr.end()) res += findKey->second.size();    
+    for(const auto& t : d->tr){
+      const char symbol = t.first.second;
+      if(!hasState(t.first.first) || (symbol != fa::Epsilon && !hasSymbol(symbol))) continue;
+      res += t.second.size();
     }
     return res;
   }
 
   void Automaton::prettyPrint(std::ostream& os) const {
     os << "\nInitial states :\n\t";
-    std::for_each(initial_states.begin(), initial_states.end(), [&os](int x){
+    std::for_each(d->initial_states.begin(), d->initial_states.end(), [&os](int x){
       os << x << " ";
     });
     os << "\nFinal states :\n\t";
-    std::for_each(final_states.begin(), final_states.end(), [&os](int x){
+    std::for_each(d->final_states.begin(), d->final_states.end(), [&os](int x){
       os << x << " ";
     });
     os << "\nTransitions :";
     int last_state = -1;
-    for (auto it = tr.begin(); it != tr.end(); ++it){
+    for (auto it = d->tr.begin(); it != d->tr.end(); ++it){
       int curr_state = it->first.first;
       if(curr_state != last_state){
         os << "\n\tFor state " << curr_state << " :";
@@ -296,7 +458,7 @@ namespace fa {
   bool Automaton::hasEpsilonTransition() const {
     assert(isValid());
 
-    for(auto it : tr){
+    for(const auto& it : d->tr){
       if(it.first.second == fa::Epsilon){
         return true;
       }
@@ -308,11 +470,11 @@ namespace fa {
   bool Automaton::isDeterministic() const{
     assert(isValid());
 
-    if(initial_states.size() != 1 || hasEpsilonTransition()){
+    if(d->initial_states.size() != 1 || hasEpsilonTransition()){
       return false;
     }
 
-    for(auto t : getTr()){
+    for(const auto& t : d->tr){
       if(t.second.size() > 1){
         return false;
       }
@@ -323,222 +485,768 @@ namespace fa {
 
   bool Automaton::isComplete() const {
     assert(isValid());
-    for(auto it_st : getSt()){
-      for(auto it_al : getAl()){
-        if(tr.count({it_st, it_al}) == 0) return false;
+    for(auto it_st : d->states){
+      for(auto it_al : d->al){
+        if(d->tr.count({it_st, it_al}) == 0) return false;
       }
     }
     return true;
   }
 
-  Automaton Automaton::createComplete(const Automaton& automaton) {
-    fa::Automaton completeAutomaton = automaton;
-    
-    if(automaton.isComplete()){
-      return completeAutomaton;
+  void Automaton::makeComplete() {
+    if(isComplete()){
+      return;
     }
 
-    //if(completeAutomaton.countStates() > 100) return completeAutomaton;
+    Data& data = mut();
 
     // Dump State creation to complete the automaton
     int dump_state = 0;
-    while(completeAutomaton.hasState(dump_state)) ++ dump_state;
-    completeAutomaton.addState(dump_state);
-
-    for(auto symbol : completeAutomaton.getAl()){
-      completeAutomaton.addTransition(dump_state, symbol, dump_state);
-      for(auto state : completeAutomaton.getSt()){
-        if(completeAutomaton.tr.count({state, symbol}) == 0){
-          completeAutomaton.addTransition(state, symbol, dump_state);
-        }
+    while(data.states.count(dump_state) != 0) ++ dump_state;
+    data.states.insert(dump_state);
+
+    // Keys are visited in the order of the map, so the missing ones are
+    // found with a single forward walk and inserted with a hint
+    auto it = data.tr.begin();
+    for(auto state : data.states){
+      for(auto symbol : data.al){
+        const std::pair<int, char> key(state, symbol);
+        while(it != data.tr.end() && it->first < key) ++it;
+        if(it != data.tr.end() && it->first == key) continue;
+        data.tr.emplace_hint(it, key, std::set<int>{dump_state});
+        if(data.predecessor_index) data.rtr[{dump_state, symbol}].insert(state);
       }
     }
+  }
 
+  Automaton Automaton::createComplete(const Automaton& automaton) {
+    fa::Automaton completeAutomaton = automaton;
+    completeAutomaton.makeComplete();
     return completeAutomaton;
   }
 
+  Automaton Automaton::createComplete(Automaton&& automaton) {
+    automaton.makeComplete();
+    return std::move(automaton);
+  }
+
   std::set<int> Automaton::makeTransition(const std::set<int>& origin, char alpha) const {
     auto set = std::set<int>();
-    
+
     for(auto o : origin){
-      for(auto s : states){
-        if(hasTransition(o, alpha, s)) set.insert(s);
+      auto find = d->tr.find({o, alpha});
+      if(find != d->tr.end()) set.insert(find->second.begin(), find->second.end());
+    }
+
+    // Epsilon closure of the arrival states
+    std::vector<int> to_process(set.begin(), set.end());
+    while(!to_process.empty()){
+      const int st = to_process.back();
+      to_process.pop_back();
+      auto find = d->tr.find({st, fa::Epsilon});
+      if(find == d->tr.end()) continue;
+      for(auto to : find->second){
+        if(set.insert(to).second) to_process.push_back(to);
       }
     }
 
     return set;
   }
 
-  std::set<int> Automaton::readString(const std::string& word) const {
-    auto set = getInitialSt();
+  StateSet Automaton::readStates(const StateIndex& index, const std::string& word) const {
+    StateSet current(index.size());
+    StateSet next(index.size());
+    std::vector<int> to_process;
+
+    auto add = [&](StateSet& set, int state){
+      int st_index = index.indexOf(state);
+      if(st_index < 0 || set.contains(st_index)) return;
+      set.insert(st_index);
+      to_process.push_back(state);
+    };
+    // Epsilon closure of the states added since the last call
+    auto close = [&](StateSet& set){
+      while(!to_process.empty()){
+        const int st = to_process.back();
+        to_process.pop_back();
+        auto find = d->tr.find({st, fa::Epsilon});
+        if(find == d->tr.end()) continue;
+        for(auto to : find->second) add(set, to);
+      }
+    };
+
+    for(auto st : d->initial_states) add(current, st);
+    close(current);
 
     for(auto letter : word){
-      set = makeTransition(set, letter);
+      if(current.empty()) break;
+      next.clear();
+      if(d->al.contains(letter)){
+        current.forEach([&](std::size_t st_index){
+          auto find = d->tr.find({index.stateAt(st_index), letter});
+          if(find == d->tr.end()) return;
+          for(auto to : find->second) add(next, to);
+        });
+        close(next);
+      }
+      std::swap(current, next);
     }
 
+    return current;
+  }
+
+  std::set<int> Automaton::readString(const std::string& word) const {
+    const StateIndex index(d->states);
+    const StateSet reached = readStates(index, word);
+
+    auto set = std::set<int>();
+    reached.forEach([&](std::size_t st_index){
+      set.insert(set.end(), index.stateAt(st_index));
+    });
+
     return set;
   }
 
   bool Automaton::match(const std::string& word) const {
-    auto read = readString(word);
+    const StateIndex index(d->states);
+    const StateSet reached = readStates(index, word);
 
-    for(auto s : states){
-      for(auto r : read){
-        if(s == r && isStateFinal(s)) return true;
-      }
+    for(auto st : d->final_states){
+      int st_index = index.indexOf(st);
+      if(st_index >= 0 && reached.contains(st_index)) return true;
     }
-
     return false;
   }
 
+  std::vector<bool> Automaton::matchAll(const std::vector<std::string_view>& words, unsigned threads) const {
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    // Not worth a thread for less words
+    static const std::size_t MinWordsPerThread = 1024;
+    threads = static_cast<unsigned>(std::max<std::size_t>(1,
+      std::min<std::size_t>(threads, words.size() / MinWordsPerThread)));
+
+    // One byte per word: threads write to distinct bytes, never to the same
+    // word of a std::vector<bool>
+    std::vector<char> matched(words.size(), 0);
+    auto slice = [&](unsigned t){
+      return std::make_pair(words.size() * t / threads, words.size() * (t + 1) / threads);
+    };
+
+    std::vector<std::thread> pool;
+    if(isDeterministic()){
+      const CompiledDfa dfa(*this);
+      auto run = [&](unsigned t){
+        const auto range = slice(t);
+        for(std::size_t i = range.first; i < range.second; ++i){
+          matched[i] = dfa.match(words[i].data(), words[i].size());
+        }
+      };
+      for(unsigned t = 1; t < threads; ++t) pool.emplace_back(run, t);
+      run(0);
+      for(auto& worker : pool) worker.join();
+    }else{
+      const NfaSimulator simulator(*this);
+      auto run = [&](unsigned t){
+        StateSet current(simulator.countStates());
+        StateSet next(simulator.countStates());
+        const auto range = slice(t);
+        for(std::size_t i = range.first; i < range.second; ++i){
+          matched[i] = simulator.match(words[i].data(), words[i].size(), current, next);
+        }
+      };
+      for(unsigned t = 1; t < threads; ++t) pool.emplace_back(run, t);
+      run(0);
+      for(auto& worker : pool) worker.join();
+    }
+
+    return std::vector<bool>(matched.begin(), matched.end());
+  }
+
+  CompiledDfa Automaton::freeze() const {
+    assert(isDeterministic());
+    return CompiledDfa(*this);
+  }
+
   void Automaton::removeNonAccessibleStates() {
     assert(isValid());
 
-    if(getInitialSt().empty()){
-      for(auto s : getSt()){
-        removeState(s);
-      }
+    if(d->initial_states.empty()){
+      keepStates({});
       addState(0);
       setStateInitial(0);
       addSymbol('a');
       return;
     }
 
-    std::set<int> visited;
+    const TransitionTable table(*this);
+    Traversal traversal(table);
 
-    for(auto s : getInitialSt()){
-      DFS(visited, s, false);
+    std::set<int> visited;
+    for(auto st : traversal.run(table.initialStates())){
+      visited.insert(table.stateAt(st));
     }
 
-    for(auto s : getSt()){
-      if(visited.find(s) == visited.end()){
-        removeState(s);
+    keepStates(visited);
+  }
+
+  void Automaton::removeNonCoAccessibleStates() {
+    assert(isValid());
+    const Data& data = *d;
+
+    // Backward traversal from the final states
+    std::set<int> visited(data.final_states);
+    std::vector<int> queue(data.final_states.begin(), data.final_states.end());
+
+    if(data.predecessor_index){
+      for(std::size_t head = 0; head < queue.size(); ++head){
+        const int st = queue[head];
+        // Transitions reaching st are contiguous in the index
+        auto it = data.rtr.lower_bound({st, std::numeric_limits<char>::min()});
+        for(; it != data.rtr.end() && it->first.first == st; ++it){
+          for(auto from : it->second){
+            if(visited.insert(from).second) queue.push_back(from);
+          }
+        }
+      }
+    }else{
+      // Temporary predecessor lists over dense indices, built in one pass
+      const TransitionTable table(*this);
+      const std::size_t n = table.countStates();
+      std::vector<std::size_t> offsets(n + 1, 0);
+      for(std::size_t st = 0; st < n; ++st){
+        for(auto to : table.rowTargets(st)) ++offsets[to + 1];
+      }
+      for(std::size_t st = 1; st <= n; ++st) offsets[st] += offsets[st - 1];
+      std::vector<int> predecessors(offsets.back());
+      std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+      for(std::size_t st = 0; st < n; ++st){
+        for(auto to : table.rowTargets(st)) predecessors[fill[to]++] = static_cast<int>(st);
+      }
+
+      for(std::size_t head = 0; head < queue.size(); ++head){
+        const int st = table.indexOf(queue[head]);
+        for(std::size_t p = offsets[st]; p < offsets[st + 1]; ++p){
+          const int from = table.stateAt(predecessors[p]);
+          if(visited.insert(from).second) queue.push_back(from);
+        }
       }
     }
+
+    keepStates(visited);
+
+    // Keep the automaton valid
+    if(d->states.empty()) addState(0);
   }
 
-  void Automaton::removeNonCoAccessibleStates() {
-    *this = createMirror(*this);
-    this->removeNonAccessibleStates();
-    *this = createMirror(*this);
+  void Automaton::trim() {
+    removeNonAccessibleStates();
+    removeNonCoAccessibleStates();
   }
 
   bool Automaton::DFS(std::set<int>& visited, int s, bool return_on_final) const{
     assert(isValid());
 
-    bool res = true;
+    // Explicit stack of (state, next transition to explore from it)
+    using Iterator = std::map<std::pair<int, char>, std::set<int>>::const_iterator;
+    auto adjacent = [this](int st){
+      // Transitions leaving st are contiguous in the map, starting at (st, min)
+      return d->tr.lower_bound({st, std::numeric_limits<char>::min()});
+    };
+    std::vector<std::pair<int, Iterator>> stack;
 
     // VISITED(s) -> true
     visited.insert(s);
+    stack.push_back({s, adjacent(s)});
 
-    for(auto t : tr){
-      if(t.first.first != s) continue;
+    while(!stack.empty()){
+      auto& top = stack.back();
+      if(top.second == d->tr.end() || top.second->first.first != top.first){
+        stack.pop_back();
+        continue;
+      }
+      const std::set<int>& targets = (top.second++)->second;
       // for u in adjacent(G,s)
-      for(auto u : t.second){
+      for(auto u : targets){
         if(return_on_final && isStateFinal(u)) return false;
         // if not VISITED(u)
-        if(visited.find(u) == visited.end()){
+        if(visited.insert(u).second){
           // DFS(G,u)
-          res = DFS(visited, u, return_on_final);
+          stack.push_back({u, adjacent(u)});
         }
       }
     }
 
-    return res;
+    return true;
   }
 
   bool Automaton::isLanguageEmpty() const {
     assert(isValid());
 
-    for(auto s : initial_states){
+    for(auto s : d->initial_states){
       if(isStateFinal(s)){
         return false;
       }
     }
 
-    if(getInitialSt().size() == 0 || getFinalSt().size() == 0) return true;
+    if(d->initial_states.empty() || d->final_states.empty()) return true;
 
-    for(auto init_st : initial_states){
-      auto visited = std::set<int>();
-      if(!DFS(visited, init_st, true)){
-        return false;
-      }
+    const TransitionTable table(*this);
+    Traversal traversal(table);
+    return traversal.findFinal(table.initialStates()) < 0;
+  }
+
+  std::vector<int> Automaton::reachableStates(const std::set<int>& from) const {
+    const TransitionTable table(*this);
+    Traversal traversal(table);
+
+    std::vector<int> sources;
+    for(auto st : from){
+      int index = table.indexOf(st);
+      if(index >= 0) sources.push_back(index);
     }
 
-    return true;
+    std::vector<int> res;
+    for(auto st : traversal.run(sources)){
+      res.push_back(table.stateAt(st));
+    }
+    return res;
   }
 
   bool Automaton::hasEmptyIntersectionWith(const Automaton& other) const {
-    return createIntersection(*this, other).isLanguageEmpty();
+    std::string witness;
+    return hasEmptyIntersectionWith(other, witness);
+  }
+
+  bool Automaton::hasEmptyIntersectionWith(const Automaton& other, std::string& witness) const {
+    assert(isValid());
+    assert(other.isValid());
+
+    const TransitionTable lhs_table(*this);
+    const TransitionTable rhs_table(other);
+    const EpsilonClosures lhs_closures(lhs_table);
+    const EpsilonClosures rhs_closures(rhs_table);
+    const std::uint64_t rhs_size = rhs_table.countStates();
+
+    // Columns of the symbols shared by both alphabets
+    struct Column {
+      char symbol;
+      std::size_t lhs;
+      std::size_t rhs;
+    };
+    std::vector<Column> columns;
+    for(auto symbol : d->al & other.getAl()){
+      columns.push_back({symbol,
+        static_cast<std::size_t>(lhs_table.columnOf(symbol)),
+        static_cast<std::size_t>(rhs_table.columnOf(symbol))});
+    }
+
+    // Breadth-first search over the pairs met so far, every pair keeps the
+    // one it was reached from to spell the witness
+    struct Node {
+      int lhs;
+      int rhs;
+      std::size_t parent;
+      char symbol;
+    };
+    std::vector<Node> queue;
+    std::unordered_set<std::uint64_t> known;
+    auto discover = [&](int lhs, int rhs, std::size_t parent, char symbol){
+      const std::uint64_t key = static_cast<std::uint64_t>(lhs) * rhs_size + static_cast<std::uint64_t>(rhs);
+      if(!known.insert(key).second) return false;
+      queue.push_back({lhs, rhs, parent, symbol});
+      return lhs_table.isFinal(lhs) && rhs_table.isFinal(rhs);
+    };
+
+    bool found = false;
+    const std::vector<int> rhs_initials = rhs_closures.closure(rhs_table.initialStates());
+    for(auto lhs : lhs_closures.closure(lhs_table.initialStates())){
+      for(auto rhs : rhs_initials){
+        found = found || discover(lhs, rhs, 0, fa::Epsilon);
+      }
+    }
+    // Successors of the current pair, closed under epsilon transitions
+    std::vector<int> lhs_successors, rhs_successors;
+    for(std::size_t head = 0; head < queue.size() && !found; ++head){
+      const Node node = queue[head];
+      for(const auto& column : columns){
+        rhs_closures.closure(rhs_table.successorsAt(node.rhs, column.rhs), rhs_successors);
+        if(rhs_successors.empty()) continue;
+        lhs_closures.closure(lhs_table.successorsAt(node.lhs, column.lhs), lhs_successors);
+        for(auto lhs : lhs_successors){
+          for(auto rhs : rhs_successors){
+            if(discover(lhs, rhs, head, column.symbol)){
+              found = true;
+              break;
+            }
+          }
+          if(found) break;
+        }
+        if(found) break;
+      }
+    }
+
+    if(!found) return true;
+
+    // The last pair discovered is the final one, the initial pairs have the
+    // Epsilon symbol
+    witness.clear();
+    for(std::size_t node = queue.size() - 1; queue[node].symbol != fa::Epsilon; node = queue[node].parent){
+      witness.push_back(queue[node].symbol);
+    }
+    std::reverse(witness.begin(), witness.end());
+    return false;
   }
 
   bool Automaton::isIncludedIn(const Automaton& other) const {
+    std::string counterexample;
+    return isIncludedIn(other, counterexample);
+  }
+
+  bool Automaton::isIncludedIn(const Automaton& other, std::string& counterexample) const {
     assert(other.isValid());
     assert(isValid());
 
-    fa::Automaton _other = other;
+    const TransitionTable table(*this);
+    const TransitionTable other_table(other);
+    const EpsilonClosures closures(table);
+    const EpsilonClosures other_closures(other_table);
+
+    // Sets of states of other, numbered once
+    SubsetTable subsets;
+    std::vector<char> subset_final; // does the set contain a final state
+
+    struct Node {
+      int st;
+      int subset;
+      std::size_t parent;
+      std::size_t depth;
+      char symbol;
+      bool subsumed;
+    };
+    std::vector<Node> queue;
+    // Nodes before this one in the queue are expanded
+    std::size_t expanded = 0;
+    // st -> nodes of the antichain
+    std::vector<std::vector<std::size_t>> antichain(table.countStates());
+
+    auto intern = [&](const std::vector<int>& subset, std::uint64_t hash){
+      auto res = subsets.insert(subset, hash);
+      if(res.second){
+        char final = 0;
+        for(auto st : subset) final = final || other_table.isFinal(st);
+        subset_final.push_back(final);
+      }
+      return res.first;
+    };
+    auto isSubset = [&](int lhs, int rhs){
+      const auto l = subsets.subset(lhs);
+      const auto r = subsets.subset(rhs);
+      return std::includes(r.begin(), r.end(), l.begin(), l.end());
+    };
+    // Return true if the node is a counterexample
+    auto discover = [&](int st, int subset, std::size_t parent, std::size_t depth, char symbol){
+      auto& nodes = antichain[st];
+      for(auto node : nodes){
+        // A smaller set already met is at least as hard to accept, and was
+        // met by a word at most as long
+        if(isSubset(queue[node].subset, subset)) return false;
+      }
+      // A larger set is dropped unless it is waiting at a lower depth: its
+      // words are shorter, so the counterexamples through it are too
+      std::size_t kept = 0;
+      for(auto node : nodes){
+        const bool droppable = node < expanded || queue[node].depth >= depth;
+        if(droppable && isSubset(subset, queue[node].subset)) queue[node].subsumed = true;
+        else nodes[kept++] = node;
+      }
+      nodes.resize(kept);
+      nodes.push_back(queue.size());
+      queue.push_back({st, subset, parent, depth, symbol, false});
+      return table.isFinal(st) && !subset_final[subset];
+    };
+
+    bool found = false;
+    const std::vector<int> other_initials = other_closures.closure(other_table.initialStates());
+    const int initial_subset = intern(other_initials, SubsetTable::hashOf(other_initials));
+    for(auto st : closures.closure(table.initialStates())){
+      if(discover(st, initial_subset, 0, 0, fa::Epsilon)){
+        found = true;
+        break;
+      }
+    }
+
+    std::vector<char> in_arrival(other_table.countStates(), 0);
+    std::vector<int> current, arrival_states, successors;
+    for(std::size_t head = 0; head < queue.size() && !found; ++head){
+      expanded = head + 1;
+      if(queue[head].subsumed) continue;
+      const std::size_t st = static_cast<std::size_t>(queue[head].st);
+      const std::size_t depth = queue[head].depth + 1;
+      const auto range = subsets.subset(queue[head].subset);
+      current.assign(range.begin(), range.end());
+
+      for(std::size_t cell = table.firstCell(st); cell < table.firstCell(st + 1) && !found; ++cell){
+        const std::size_t column = table.cellColumn(cell);
+        if(column == 0) continue;
+        closures.closure(table.cellTargets(cell), successors);
+
+        // Set of other reached by the symbol, empty if other does not know it
+        const char symbol = table.symbolAt(column);
+        const int other_column = other_table.columnOf(symbol);
+        arrival_states.clear();
+        std::uint64_t hash = 0;
+        if(other_column >= 0){
+          hash = other_closures.closedSuccessors(current, other_table, static_cast<std::size_t>(other_column),
+                                                 in_arrival, arrival_states);
+        }
+        const int subset = intern(arrival_states, hash);
 
-    for(auto symbol : getAl()) {
-        if(!_other.hasSymbol(symbol)) _other.addSymbol(symbol);
+        for(auto to : successors){
+          if(discover(to, subset, head, depth, symbol)){
+            found = true;
+            break;
+          }
+        }
+      }
     }
 
-    fa::Automaton complement = createComplement(_other);
+    if(!found) return true;
 
-    return hasEmptyIntersectionWith(complement);
+    counterexample.clear();
+    for(std::size_t node = queue.size() - 1; queue[node].symbol != fa::Epsilon; node = queue[node].parent){
+      counterexample.push_back(queue[node].symbol);
+    }
+    std::reverse(counterexample.begin(), counterexample.end());
+    return false;
   }
 
-  Automaton Automaton::createMirror(const Automaton& automaton) {
-    assert(automaton.isValid());
-
-    fa::Automaton mirror_automaton;
-    mirror_automaton.setAl(automaton.getAl());
-    mirror_automaton.setSt(automaton.getSt());
-    mirror_automaton.setInitSt(automaton.getInitialSt());
-    mirror_automaton.setFinalSt(automaton.getFinalSt());
+  bool Automaton::isEquivalentTo(const Automaton& other) const {
+    std::string counterexample;
+    return isEquivalentTo(other, counterexample);
+  }
 
-    auto init = mirror_automaton.getInitialSt();
-    auto final = mirror_automaton.getFinalSt();
+  bool Automaton::isEquivalentTo(const Automaton& other, std::string& counterexample) const {
+    assert(other.isValid());
+    assert(isValid());
 
-    for(auto it : final){
-      if(!mirror_automaton.isStateInitial(it)){
-        mirror_automaton.setStateInitial(it);
-        mirror_automaton.removeFinalState(it);
+    const TransitionTable lhs_table(*this);
+    const TransitionTable rhs_table(other);
+    const EpsilonClosures lhs_closures(lhs_table);
+    const EpsilonClosures rhs_closures(rhs_table);
+    // The states of other follow the ones of this automaton, so the sets of
+    // both sides live in the same table
+    const int offset = static_cast<int>(lhs_table.countStates());
+
+    SubsetTable subsets;
+    std::vector<char> subset_final;
+    std::vector<int> uf_parent;
+    auto find = [&uf_parent](int x){
+      while(uf_parent[x] != x){
+        uf_parent[x] = uf_parent[uf_parent[x]]; // path halving
+        x = uf_parent[x];
       }
+      return x;
+    };
+
+    // Columns of both sides for every symbol of either alphabet
+    struct Column {
+      char symbol;
+      int lhs;
+      int rhs;
+    };
+    std::vector<Column> columns;
+    for(auto symbol : d->al){
+      columns.push_back({symbol, lhs_table.columnOf(symbol), rhs_table.columnOf(symbol)});
     }
+    for(auto symbol : other.getAl()){
+      if(!hasSymbol(symbol)) columns.push_back({symbol, -1, rhs_table.columnOf(symbol)});
+    }
+
+    // Number of a sorted set, its finality and union-find entry come with it
+    auto intern = [&](const std::vector<int>& subset, std::uint64_t hash){
+      auto res = subsets.insert(subset, hash);
+      if(res.second){
+        char final = 0;
+        for(auto st : subset){
+          final = final || (st < offset ? lhs_table.isFinal(st) : rhs_table.isFinal(st - offset));
+        }
+        subset_final.push_back(final);
+        uf_parent.push_back(res.first);
+      }
+      return res.first;
+    };
+
+    std::vector<char> in_arrival(std::max(lhs_table.countStates(), rhs_table.countStates()), 0);
+    std::vector<int> current, arrival_states;
+    // Set reached from a stored set of one side, whose indices are shifted
+    auto post = [&](int subset, const TransitionTable& table, const EpsilonClosures& closures, int column, int shift){
+      arrival_states.clear();
+      if(column >= 0){
+        current.clear();
+        for(auto st : subsets.subset(static_cast<std::size_t>(subset))) current.push_back(st - shift);
+        closures.closedSuccessors(current, table, static_cast<std::size_t>(column), in_arrival, arrival_states);
+        for(auto& st : arrival_states) st += shift;
+      }
+      return intern(arrival_states, SubsetTable::hashOf(arrival_states));
+    };
+
+    struct Node {
+      int lhs;
+      int rhs;
+      std::size_t parent;
+      char symbol;
+    };
+    std::vector<Node> queue;
+
+    const std::vector<int> lhs_initials = lhs_closures.closure(lhs_table.initialStates());
+    std::vector<int> rhs_initials;
+    for(auto st : rhs_closures.closure(rhs_table.initialStates())) rhs_initials.push_back(st + offset);
+    const int lhs_initial = intern(lhs_initials, SubsetTable::hashOf(lhs_initials));
+    const int rhs_initial = intern(rhs_initials, SubsetTable::hashOf(rhs_initials));
+    queue.push_back({lhs_initial, rhs_initial, 0, fa::Epsilon});
+
+    for(std::size_t head = 0; head < queue.size(); ++head){
+      const Node node = queue[head];
+      const int lhs_root = find(node.lhs);
+      const int rhs_root = find(node.rhs);
+      if(lhs_root == rhs_root) continue;
+
+      if(subset_final[node.lhs] != subset_final[node.rhs]){
+        counterexample.clear();
+        for(std::size_t n = head; queue[n].symbol != fa::Epsilon; n = queue[n].parent){
+          counterexample.push_back(queue[n].symbol);
+        }
+        std::reverse(counterexample.begin(), counterexample.end());
+        return false;
+      }
+      uf_parent[lhs_root] = rhs_root;
 
-    for(auto it : init){
-      if(!mirror_automaton.isStateFinal(it)){
-        mirror_automaton.setStateFinal(it);
-        mirror_automaton.removeInitialState(it);
+      for(const auto& column : columns){
+        const int lhs_next = post(node.lhs, lhs_table, lhs_closures, column.lhs, 0);
+        const int rhs_next = post(node.rhs, rhs_table, rhs_closures, column.rhs, offset);
+        queue.push_back({lhs_next, rhs_next, head, column.symbol});
       }
     }
 
-    for(auto t : automaton.getTr()){
+    return true;
+  }
+
+  void Automaton::makeMirror() {
+    assert(isValid());
+    Data& data = mut();
+
+    // Initial and final states are swapped
+    data.initial_states.swap(data.final_states);
+
+    // The predecessor index is exactly the mirrored transitions
+    if(data.predecessor_index){
+      data.tr.swap(data.rtr);
+      return;
+    }
+
+    std::map<std::pair<int, char>, std::set<int>> mirror_tr;
+    for(const auto& t : data.tr){
       for(auto t_to : t.second){
-        mirror_automaton.addTransition(t_to, 
-                                       t.first.second,
-                                       t.first.first);
+        mirror_tr[{t_to, t.first.second}].insert(t.first.first);
       }
     }
+    data.tr.swap(mirror_tr);
+  }
 
+  Automaton Automaton::createMirror(const Automaton& automaton) {
+    fa::Automaton mirror_automaton = automaton;
+    mirror_automaton.makeMirror();
     return mirror_automaton;
   }
 
+  Automaton Automaton::createMirror(Automaton&& automaton) {
+    automaton.makeMirror();
+    return std::move(automaton);
+  }
+
+  void Automaton::makeComplement() {
+    if(!isDeterministic()){
+      const bool indexed = d->predecessor_index;
+      *this = createDeterministic(*this);
+      if(indexed) setPredecessorIndex(true);
+    }
+
+    makeComplete();
+
+    Data& data = mut();
+    std::set<int> non_final_states;
+    std::set_difference(data.states.begin(), data.states.end(),
+                        data.final_states.begin(), data.final_states.end(),
+                        std::inserter(non_final_states, non_final_states.end()));
+    data.final_states.swap(non_final_states);
+  }
+
   Automaton Automaton::createComplement(const Automaton& automaton) {
     fa::Automaton complementAutomaton = automaton;
+    complementAutomaton.makeComplement();
+    return complementAutomaton;
+  }
+
+  Automaton Automaton::createComplement(Automaton&& automaton) {
+    automaton.makeComplement();
+    return std::move(automaton);
+  }
 
-    if(!complementAutomaton.isDeterministic()) complementAutomaton = createDeterministic(complementAutomaton);
+  Automaton Automaton::createWithoutEpsilon(const Automaton& other) {
+    assert(other.isValid());
 
-    if(!complementAutomaton.isComplete()) complementAutomaton = createComplete(complementAutomaton);
+    if(!other.hasEpsilonTransition()){
+      return other;
+    }
 
-    auto st = complementAutomaton.getSt();
-    for(auto it_st : st){
-      (complementAutomaton.isStateFinal(it_st)) ? 
-      complementAutomaton.removeFinalState(it_st) : 
-      complementAutomaton.setStateFinal(it_st);
-    } 
+    const TransitionTable table(other);
+    const EpsilonClosures closures(table);
+
+    fa::Automaton without_epsilon;
+    Data& res = without_epsilon.mut();
+    res.al = other.getAl();
+    res.states = other.getSt();
+    res.initial_states = other.getInitialSt();
+
+    // A state gets the transitions of its whole closure, and is final if its
+    // closure holds a final state
+    std::vector<std::pair<std::size_t, int>> arrivals; // (column, dense target)
+    for(std::size_t st = 0; st < table.countStates(); ++st){
+      const int st_id = table.stateAt(st);
+      const auto closure = closures.closure(st);
+      for(auto reached : closure){
+        if(table.isFinal(static_cast<std::size_t>(reached))){
+          res.final_states.insert(res.final_states.end(), st_id);
+          break;
+        }
+      }
 
-    return complementAutomaton;
+      // Only the non-empty cells of the closure, grouped by column
+      arrivals.clear();
+      for(auto reached : closure){
+        const std::size_t row = static_cast<std::size_t>(reached);
+        for(std::size_t cell = table.firstCell(row); cell < table.firstCell(row + 1); ++cell){
+          const std::size_t column = table.cellColumn(cell);
+          if(column == 0) continue;
+          for(auto to : table.cellTargets(cell)) arrivals.emplace_back(column, to);
+        }
+      }
+      std::sort(arrivals.begin(), arrivals.end());
+      arrivals.erase(std::unique(arrivals.begin(), arrivals.end()), arrivals.end());
+
+      // Columns follow the symbols and dense indices the identifiers, so the
+      // keys and the targets come in order
+      for(std::size_t first = 0; first < arrivals.size();){
+        const std::size_t column = arrivals[first].first;
+        auto& targets = res.tr.emplace_hint(res.tr.end(), std::make_pair(st_id, table.symbolAt(column)),
+                                            std::set<int>())->second;
+        for(; first < arrivals.size() && arrivals[first].first == column; ++first){
+          targets.insert(targets.end(), table.stateAt(static_cast<std::size_t>(arrivals[first].second)));
+        }
+      }
+    }
+
+    return without_epsilon;
   }
 
   Automaton Automaton::createIntersection(const Automaton& lhs, const Automaton& rhs) {
@@ -549,73 +1257,68 @@ namespace fa {
     assert(rhs.isValid());
 
     fa::Automaton intersection;
+    Data& inter = intersection.mut();
+
+    const TransitionTable lhs_table(lhs);
+    const TransitionTable rhs_table(rhs);
+    // Both sides are followed through their epsilon transitions, so the
+    // intersection has none
+    const EpsilonClosures lhs_closures(lhs_table);
+    const EpsilonClosures rhs_closures(rhs_table);
 
     // Variables
-    std::map<std::pair<int, int>, int> to_process; // {(lhs_st, rhs_st), intersection_st}
-    int curr_st = 0; // count the states of the intersection
+    std::map<std::pair<int, int>, int> known; // {(lhs_index, rhs_index), intersection_st}
+    std::vector<std::pair<int, int>> to_process; // intersection_st -> (lhs_index, rhs_index)
     
     // First we make the instersection of both alphabets
-    auto al = std::set<char>(); 
-    for(auto a : lhs.getAl()){
-      if(rhs.hasSymbol(a)){
-        al.insert(a);
-      }
-    }
-    intersection.setAl(al);
+    inter.al = lhs.getAl() & rhs.getAl();
 
     // Then we get every pair of initial states
-    for(auto lhs_ptr : lhs.getInitialSt()){
-      for(auto rhs_ptr : rhs.getInitialSt()){
-        to_process.insert({std::make_pair(lhs_ptr, rhs_ptr), curr_st});
-        intersection.addState(curr_st);
-        intersection.setStateInitial(curr_st);
-        ++curr_st;
+    const std::vector<int> rhs_initials = rhs_closures.closure(rhs_table.initialStates());
+    for(auto lhs_ptr : lhs_closures.closure(lhs_table.initialStates())){
+      for(auto rhs_ptr : rhs_initials){
+        int curr_st = static_cast<int>(to_process.size());
+        known.insert({std::make_pair(lhs_ptr, rhs_ptr), curr_st});
+        to_process.push_back(std::make_pair(lhs_ptr, rhs_ptr));
+        inter.initial_states.insert(curr_st);
       }
     }
 
-    // Visit both automaton and create new states / intersections
-    for(auto to_process_curr : to_process){
+    // Visit both automaton and create new states / intersections, states are
+    // numbered in discovery order so the worklist is the vector itself
+    std::vector<int> lhs_symbol_state, rhs_symbol_state;
+    for(std::size_t curr = 0; curr < to_process.size(); ++curr){
+      const int curr_st = static_cast<int>(curr);
+      const auto pair = to_process[curr];
+      inter.states.insert(inter.states.end(), curr_st);
+
       // Get every pair of states for every symbols in the alphabet 
-      for(auto symbol : intersection.getAl()){
-        std::set<int> lhs_symbol_state;
-        std::set<int> rhs_symbol_state;
-        
-        for(auto lhs_st_to : lhs.getSt()){
-          // looking for every transitions starting by the current to process lhs state and the using current symbol 
-          if(lhs.hasTransition(to_process_curr.first.first, symbol, lhs_st_to)){
-            lhs_symbol_state.insert(lhs_st_to);
-          }
-        }
+      for(auto symbol : inter.al){
+        lhs_closures.closure(lhs_table.successors(pair.first, symbol), lhs_symbol_state);
+        if(lhs_symbol_state.empty()) continue;
+        rhs_closures.closure(rhs_table.successors(pair.second, symbol), rhs_symbol_state);
+        if(rhs_symbol_state.empty()) continue;
 
-        for(auto rhs_st_to : rhs.getSt()){
-          // looking for every transitions starting by the current rhs state and the using current symbol 
-          if(rhs.hasTransition(to_process_curr.first.second, symbol, rhs_st_to)){
-            rhs_symbol_state.insert(rhs_st_to);
-          }
-        }
+        auto& arrival = inter.tr.emplace_hint(inter.tr.end(),
+          std::make_pair(curr_st, symbol), std::set<int>())->second;
 
         // Adding every pair of state in the intersection
         for(auto lhs_ptr : lhs_symbol_state){
           for(auto rhs_ptr : rhs_symbol_state){
-            auto pair = std::make_pair(lhs_ptr, rhs_ptr);
-            auto findState = to_process.find(pair);
-            if(findState != to_process.end()){
-              // The pair is already known, we add the transition from the current state
-              // to the state of the said pair
-              intersection.addTransition(to_process_curr.second, symbol, findState->second);
-            }else{
-              to_process.insert({std::make_pair(lhs_ptr, rhs_ptr), curr_st});
-              intersection.addState(curr_st);
-              intersection.addTransition(to_process_curr.second, symbol, curr_st);
-              ++curr_st;
+            auto next = std::make_pair(lhs_ptr, rhs_ptr);
+            auto findState = known.find(next);
+            if(findState == known.end()){
+              findState = known.insert({next, static_cast<int>(to_process.size())}).first;
+              to_process.push_back(next);
             }
+            arrival.insert(findState->second);
           }
         }
       }
 
       // If both left and right states were final, then the current state is final
-      if(lhs.isStateFinal(to_process_curr.first.first) && rhs.isStateFinal(to_process_curr.first.second)){
-        intersection.setStateFinal(to_process_curr.second);
+      if(lhs_table.isFinal(pair.first) && rhs_table.isFinal(pair.second)){
+        inter.final_states.insert(curr_st);
       }
     }
 
@@ -630,7 +1333,6 @@ namespace fa {
     assert(other.isValid());
 
     if(other.isDeterministic()){
-      fa::Automaton copy = other;
       return other;
     } 
 
@@ -643,73 +1345,212 @@ namespace fa {
     }
 
     fa::Automaton deterministic;
+    Data& det = deterministic.mut();
+    const TransitionTable table(other);
+    // Equivalent symbols reach the same subset, it is computed once per class
+    const SymbolClasses classes(other);
+    std::vector<int> class_target(classes.countClasses());
+
+    // deterministic_st -> subset of dense indices of other
+    SubsetTable subsets;
 
-    std::map<std::set<int>, int> visited; // {[other_st_1, ...], deterministic_st}
-    int curr_st = 1;
+    // Subsets are closed under epsilon transitions
+    const EpsilonClosures closures(table);
 
     // Alphabet
-    deterministic.setAl(other.getAl());
+    det.al = other.getAl();
 
     // Initial states
-    visited.insert({other.getInitialSt(), 0});
-    deterministic.addState(0);
-    deterministic.setStateInitial(0);
-
-    // Transitions
-    for(auto visited_curr : visited){
-      for(auto symbol : deterministic.getAl()){
-        std::set<int> arrival_states;
-
-        for(auto st_to : other.getSt()){
-          for(auto st_from : visited_curr.first){
-            if(other.hasTransition(st_from, symbol, st_to)){
-              arrival_states.insert(st_to);
-            } 
-          }
+    const std::vector<int> initials = closures.closure(table.initialStates());
+    subsets.insert(initials, SubsetTable::hashOf(initials));
+    det.initial_states.insert(0);
+
+    // Transitions, subsets are numbered in discovery order so the worklist is
+    // the table itself
+    std::vector<char> in_arrival(table.countStates(), 0);
+    std::vector<int> current;
+    std::vector<int> arrival_states;
+    for(std::size_t curr = 0; curr < subsets.size(); ++curr){
+      const int curr_st = static_cast<int>(curr);
+      det.states.insert(det.states.end(), curr_st);
+
+      // Copied, inserting new subsets moves the stored ones
+      const auto range = subsets.subset(curr);
+      current.assign(range.begin(), range.end());
+      for(auto st : current){
+        if(table.isFinal(st)){
+          det.final_states.insert(curr_st);
+          break;
         }
+      }
 
-        auto findKey = visited.find(arrival_states);
-        if(findKey != visited.end()){
-          deterministic.addTransition(visited_curr.second, symbol, findKey->second);
-        }else{
-          visited.insert({arrival_states, curr_st});
-          deterministic.addState(curr_st);
-          deterministic.addTransition(visited_curr.second, symbol, curr_st);
-          ++curr_st;
+      std::fill(class_target.begin(), class_target.end(), -1);
+      for(auto symbol : det.al){
+        const std::size_t cls = classes.classOf(symbol);
+        if(class_target[cls] < 0){
+          // The first symbol of a class met here is its representative
+          const std::size_t column = static_cast<std::size_t>(table.columnOf(symbol));
+          arrival_states.clear();
+          const std::uint64_t hash = closures.closedSuccessors(current, table, column, in_arrival, arrival_states);
+
+          class_target[cls] = subsets.insert(arrival_states, hash).first;
         }
+        det.tr.emplace_hint(det.tr.end(),
+          std::make_pair(curr_st, symbol), std::set<int>{class_target[cls]});
+      }
+    }
+
+    return deterministic;
+  }
 
-        for(auto st : arrival_states){
-          if(other.isStateFinal(st)) deterministic.setStateFinal(visited_curr.second);
+  Automaton Automaton::createDeterministic(const Automaton& other, unsigned threads) {
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if(threads == 1 || other.isDeterministic() || other.getInitialSt().empty()){
+      return createDeterministic(other);
+    }
+
+    fa::Automaton deterministic;
+    Data& det = deterministic.mut();
+    const TransitionTable table(other);
+    const SymbolClasses classes(other);
+    const std::size_t nb_classes = classes.countClasses() - 1;
+    std::vector<std::size_t> columns(nb_classes);
+    for(std::size_t cls = 0; cls < nb_classes; ++cls){
+      columns[cls] = static_cast<std::size_t>(table.columnOf(classes.representative(cls + 1)));
+    }
+
+    // deterministic_st -> subset of dense indices of other
+    SubsetTable subsets;
+    const EpsilonClosures closures(table);
+    det.al = other.getAl();
+    const std::vector<int> initials = closures.closure(table.initialStates());
+    subsets.insert(initials, SubsetTable::hashOf(initials));
+    det.initial_states.insert(0);
+
+    // Successors of a chunk of consecutive subsets, for every class in order
+    struct Arrival {
+      std::size_t first, last;
+      std::uint64_t hash;
+      int id;
+    };
+    struct Chunk {
+      std::vector<int> elems;
+      std::vector<Arrival> arrivals;
+      std::vector<char> finals;
+    };
+    static const std::size_t ChunkSize = 64;
+
+    std::vector<std::vector<char>> in_arrival(threads, std::vector<char>(table.countStates(), 0));
+    std::vector<Chunk> chunks;
+
+    // Level by level: the subsets of a level are expanded in parallel against
+    // the table frozen so far, then the new ones are numbered sequentially in
+    // the same order as the sequential version
+    for(std::size_t level = 0; level < subsets.size();){
+      const std::size_t level_end = subsets.size();
+      const std::size_t nb_chunks = (level_end - level + ChunkSize - 1) / ChunkSize;
+      chunks.assign(nb_chunks, Chunk());
+      std::atomic<std::size_t> next_chunk(0);
+
+      auto expand = [&](std::vector<char>& marks){
+        for(std::size_t c = next_chunk++; c < nb_chunks; c = next_chunk++){
+          Chunk& chunk = chunks[c];
+          const std::size_t end = std::min(level_end, level + (c + 1) * ChunkSize);
+          for(std::size_t curr = level + c * ChunkSize; curr < end; ++curr){
+            const auto current = subsets.subset(curr);
+            char final = 0;
+            for(auto st : current){
+              if(table.isFinal(st)){
+                final = 1;
+                break;
+              }
+            }
+            chunk.finals.push_back(final);
+
+            for(std::size_t cls = 0; cls < nb_classes; ++cls){
+              Arrival arrival{chunk.elems.size(), 0, 0, -1};
+              arrival.hash = closures.closedSuccessors(current, table, columns[cls], marks, chunk.elems);
+              arrival.last = chunk.elems.size();
+              // The table is only read during the level
+              arrival.id = subsets.find(chunk.elems.data() + arrival.first,
+                                        chunk.elems.data() + arrival.last, arrival.hash);
+              chunk.arrivals.push_back(arrival);
+            }
+          }
         }
+      };
 
+      const unsigned workers = static_cast<unsigned>(std::min<std::size_t>(threads, nb_chunks));
+      std::vector<std::thread> pool;
+      for(unsigned w = 1; w < workers; ++w){
+        pool.emplace_back(expand, std::ref(in_arrival[w]));
       }
+      expand(in_arrival[0]);
+      for(auto& worker : pool) worker.join();
+
+      std::vector<int> class_target(nb_classes + 1);
+      for(std::size_t c = 0; c < nb_chunks; ++c){
+        Chunk& chunk = chunks[c];
+        for(std::size_t i = 0; i < chunk.finals.size(); ++i){
+          const int curr_st = static_cast<int>(level + c * ChunkSize + i);
+          det.states.insert(det.states.end(), curr_st);
+          if(chunk.finals[i]) det.final_states.insert(curr_st);
+
+          for(std::size_t cls = 0; cls < nb_classes; ++cls){
+            Arrival& arrival = chunk.arrivals[i * nb_classes + cls];
+            if(arrival.id < 0){
+              arrival.id = subsets.insert(chunk.elems.data() + arrival.first,
+                                          chunk.elems.data() + arrival.last, arrival.hash).first;
+            }
+            class_target[cls + 1] = arrival.id;
+          }
+          for(auto symbol : det.al){
+            det.tr.emplace_hint(det.tr.end(),
+              std::make_pair(curr_st, symbol), std::set<int>{class_target[classes.classOf(symbol)]});
+          }
+        }
+      }
+      level = level_end;
     }
 
     return deterministic;
   }
 
+  Automaton Automaton::createDeterministic(Automaton&& other) {
+    if(other.isDeterministic()){
+      return std::move(other);
+    }
+    // The subsets cannot reuse the storage, but it is released on return
+    fa::Automaton moved = std::move(other);
+    return createDeterministic(moved);
+  }
+
   Automaton Automaton::createMinimalMoore(const Automaton& other) {
+    return createMinimalMoore(fa::Automaton(other));
+  }
+
+  Automaton Automaton::createMinimalMoore(Automaton&& other) {
     assert(other.isValid());
     //
-    fa::Automaton _other =  other;
+    fa::Automaton _other = std::move(other);
 
     _other.removeNonAccessibleStates();
-    _other = createComplete(_other);
-    _other = createDeterministic(_other);
+    _other.makeComplete();
+    _other = createDeterministic(std::move(_other));
     //
 
     if(_other.countStates() == 1) return _other;
 
-    std::vector<int> state_vector;
-    for(auto st : _other.getSt()){
-      // Build a vector of every states
-      state_vector.push_back(st);
-    }
-    //
+    // States are handled through their dense index, so every vector below is
+    // indexed by it whatever the identifiers of the states
+    const TransitionTable table(_other);
+    const std::size_t nb_states = table.countStates();
+    // Equivalent symbols refine the same way, only one per class is used
+    const SymbolClasses classes(_other);
     std::vector<char> al_vector;
-    for(auto a : _other.getAl()){
-      // Build a vector of every symbols
-      al_vector.push_back(a);
+    for(std::size_t cls = 1; cls < classes.countClasses(); ++cls){
+      // Build a vector of every class representatives
+      al_vector.push_back(classes.representative(cls));
     }
     //
     std::vector<int> n0;
@@ -717,9 +1558,9 @@ namespace fa {
     do {
       if(nX.empty()){ // First iteration
         std::vector<int> res;
-        for(auto st : state_vector){
+        for(std::size_t st = 0; st < nb_states; ++st){
           // Final states are marked with a 2 and non-final with a 1
-          (_other.isStateFinal(st)) ? res.push_back(2) : res.push_back(1) ;
+          (table.isFinal(st)) ? res.push_back(2) : res.push_back(1) ;
         }
         nX.insert({' ', res});
       }else{ // Count the different states
@@ -729,7 +1570,7 @@ namespace fa {
         std::map<std::vector<int>, int> tuple_map;
         int count = 1;
         //
-        for(auto st : state_vector){
+        for(std::size_t st = 0; st < nb_states; ++st){
           std::vector<int> tuple;
           tuple.push_back(n0[st]);
           for(auto symbol : al_vector){
@@ -752,14 +1593,11 @@ namespace fa {
       for(auto symbol : al_vector){
         std::vector<int> symbol_res;
         //
-        for(auto st_from : state_vector){
-          for(auto st_to : _other.getSt()){
-            if(_other.hasTransition(st_from, symbol, st_to)){
-              symbol_res.push_back(nX.at(' ')[st_to]);
-              // can break here
-              break;
-            }
-          }
+        for(std::size_t st_from = 0; st_from < nb_states; ++st_from){
+          // Complete and deterministic: exactly one target
+          auto st_to = table.successors(st_from, symbol);
+          assert(st_to.size() == 1);
+          symbol_res.push_back(nX.at(' ')[*st_to.begin()]);
         }
         //
         nX.insert({symbol, symbol_res});
@@ -775,38 +1613,1463 @@ namespace fa {
     for(auto st : n0){
       minimal_moore.addState(st);
     }
-    for(auto st : state_vector){
-      if(_other.isStateInitial(st)){
-        minimal_moore.setStateInitial(nX.find(' ')->second[st]);
-      }
-      if(_other.isStateFinal(st)){
+    for(auto st : table.initialStates()){
+      minimal_moore.setStateInitial(nX.find(' ')->second[st]);
+    }
+    for(std::size_t st = 0; st < nb_states; ++st){
+      if(table.isFinal(st)){
         minimal_moore.setStateFinal(nX.find(' ')->second[st]);
       }
     }
     // Transitions
-    for(auto n : nX){
-      if(n.first == ' ') continue;
-      for(auto st : state_vector){
-        minimal_moore.addTransition(n0[st], n.first, n.second[st]);
+    for(auto symbol : _other.getAl()){
+      const auto& n = nX.at(classes.representative(classes.classOf(symbol)));
+      for(std::size_t st = 0; st < n0.size(); ++st){
+        minimal_moore.addTransition(n0[st], symbol, n[st]);
       }
     }
     // Return
     return minimal_moore;
   }
 
-  Automaton Automaton::createMinimalBrzozowski(const Automaton& other) {
-    assert(other.isValid());
+  namespace {
+
+    /**
+     * Refinable partition of 0..size-1 (Valmari-Lehtinen), shared by the
+     * Hopcroft and Valmari minimizations
+     *
+     * Set s holds elems[first[s]..past[s]), its marked elements being
+     * gathered in front. Splitting a set keeps the larger part under its
+     * number and gives the smaller part a new number, so the sets created by
+     * a split() are the ones numbered from the former count of sets.
+     */
+    struct Partition {
+      std::size_t sets = 0;
+      std::vector<int> elems, sidx;
+      std::vector<std::size_t> loc, first, past, marked;
+      std::vector<int> touched;
+
+      explicit Partition(std::size_t size)
+      : elems(size), sidx(size, 0), loc(size), first(size + 1, 0), past(size + 1, 0), marked(size + 1, 0)
+      {
+        for(std::size_t i = 0; i < size; ++i){
+          elems[i] = static_cast<int>(i);
+          loc[i] = i;
+        }
+        if(size > 0){
+          sets = 1;
+          past[0] = size;
+        }
+      }
 
-    fa::Automaton minimal_Brzozozzzozzozozzwwkswski = other;
+      std::size_t size(std::size_t s) const { return past[s] - first[s]; }
+
+      /**
+       * Mark an element, marking it again does nothing
+       */
+      void mark(int e) {
+        const int s = sidx[e];
+        const std::size_t i = loc[e];
+        const std::size_t j = first[s] + marked[s];
+        if(i < j) return;
+        elems[i] = elems[j];
+        loc[elems[i]] = i;
+        elems[j] = e;
+        loc[e] = j;
+        if(marked[s]++ == 0) touched.push_back(s);
+      }
+
+      /**
+       * Split every set with marked elements between the marked and the
+       * unmarked ones, and unmark everything
+       */
+      void split() {
+        while(!touched.empty()){
+          const int s = touched.back();
+          touched.pop_back();
+          const std::size_t j = first[s] + marked[s];
+          if(j == past[s]){
+            marked[s] = 0;
+            continue;
+          }
+          const std::size_t z = sets++;
+          if(marked[s] <= past[s] - j){
+            first[z] = first[s];
+            past[z] = first[s] = j;
+          }else{
+            past[z] = past[s];
+            first[z] = past[s] = j;
+          }
+          for(std::size_t i = first[z]; i < past[z]; ++i) sidx[elems[i]] = static_cast<int>(z);
+          marked[s] = marked[z] = 0;
+        }
+      }
+    };
+
+  }
+
+  Automaton Automaton::createMinimalHopcroft(const Automaton& other) {
+    return createMinimalHopcroft(fa::Automaton(other));
+  }
+
+  Automaton Automaton::createMinimalHopcroft(Automaton&& other) {
+    assert(other.isValid());
+    // Same preparation as Moore: accessible, complete and deterministic
+    fa::Automaton _other = std::move(other);
+
+    _other.removeNonAccessibleStates();
+    _other.makeComplete();
+    _other = createDeterministic(std::move(_other));
 
-    minimal_Brzozozzzozzozozzwwkswski = createMirror(minimal_Brzozozzzozzozozzwwkswski);
-    minimal_Brzozozzzozzozozzwwkswski = createDeterministic(minimal_Brzozozzzozzozozzwwkswski);
-    minimal_Brzozozzzozzozozzwwkswski = createMirror(minimal_Brzozozzzozzozozzwwkswski);
-    minimal_Brzozozzzozzozozzwwkswski = createDeterministic(minimal_Brzozozzzozzozozzwwkswski);
-    minimal_Brzozozzzozzozozzwwkswski = createComplete(minimal_Brzozozzzozzozozzwwkswski);
+    if(_other.countStates() == 1) return _other;
+
+    const TransitionTable table(_other);
+    const std::size_t nb_states = table.countStates();
+    // Equivalent symbols split the same way, only one splitter per class
+    const SymbolClasses classes(_other);
+    const std::size_t nb_classes = classes.countClasses() - 1;
+
+    // Inverse transitions grouped by (class, target)
+    std::vector<std::size_t> inv_offsets(nb_classes * nb_states + 1, 0);
+    std::vector<int> inv_sources(nb_classes * nb_states);
+    for(std::size_t cls = 0; cls < nb_classes; ++cls){
+      const char symbol = classes.representative(cls + 1);
+      for(std::size_t st = 0; st < nb_states; ++st){
+        // Complete and deterministic: exactly one target
+        auto to = table.successors(st, symbol);
+        assert(to.size() == 1);
+        ++inv_offsets[cls * nb_states + *to.begin() + 1];
+      }
+    }
+    for(std::size_t i = 1; i < inv_offsets.size(); ++i) inv_offsets[i] += inv_offsets[i - 1];
+    {
+      std::vector<std::size_t> fill(inv_offsets.begin(), inv_offsets.end() - 1);
+      for(std::size_t cls = 0; cls < nb_classes; ++cls){
+        const char symbol = classes.representative(cls + 1);
+        for(std::size_t st = 0; st < nb_states; ++st){
+          const std::size_t key = cls * nb_states + *table.successors(st, symbol).begin();
+          inv_sources[fill[key]++] = static_cast<int>(st);
+        }
+      }
+    }
+
+    // Blocks start split between final and non-final states
+    Partition blocks(nb_states);
+    for(std::size_t st = 0; st < nb_states; ++st){
+      if(table.isFinal(st)) blocks.mark(static_cast<int>(st));
+    }
+    blocks.split();
+
+    // Worklist of splitters (block, class). A split block keeps its pending
+    // splitters and the smaller part is always new, so whether the block was
+    // waiting or not, the splitters of the new part are the ones to add.
+    std::vector<std::pair<int, std::size_t>> worklist;
+    for(std::size_t y = 1; y < blocks.sets; ++y){
+      for(std::size_t cls = 0; cls < nb_classes; ++cls) worklist.push_back({static_cast<int>(y), cls});
+    }
+
+    std::vector<int> predecessors;
+    while(!worklist.empty()){
+      const int splitter = worklist.back().first;
+      const std::size_t cls = worklist.back().second;
+      worklist.pop_back();
+
+      // Predecessors are gathered first, marking reorders the blocks
+      predecessors.clear();
+      for(std::size_t i = blocks.first[splitter]; i < blocks.past[splitter]; ++i){
+        const std::size_t key = cls * nb_states + blocks.elems[i];
+        predecessors.insert(predecessors.end(),
+          inv_sources.begin() + inv_offsets[key], inv_sources.begin() + inv_offsets[key + 1]);
+      }
+
+      for(auto st : predecessors) blocks.mark(st);
+      const std::size_t created = blocks.sets;
+      blocks.split();
+      for(std::size_t y = created; y < blocks.sets; ++y){
+        for(std::size_t c = 0; c < nb_classes; ++c) worklist.push_back({static_cast<int>(y), c});
+      }
+    }
+
+    // Blocks are numbered from 1 in the order of their first state, like Moore
+    std::vector<int> label(blocks.sets, 0);
+    std::vector<std::size_t> representatives;
+    for(std::size_t st = 0; st < nb_states; ++st){
+      if(label[blocks.sidx[st]] == 0){
+        representatives.push_back(st);
+        label[blocks.sidx[st]] = static_cast<int>(representatives.size());
+      }
+    }
+
+    fa::Automaton minimal_hopcroft;
+    Data& minimal = minimal_hopcroft.mut();
+    minimal.al = _other.getAl();
+    for(std::size_t lbl = 1; lbl <= representatives.size(); ++lbl){
+      minimal.states.insert(minimal.states.end(), static_cast<int>(lbl));
+    }
+    for(auto st : table.initialStates()){
+      minimal.initial_states.insert(label[blocks.sidx[st]]);
+    }
+    for(std::size_t st = 0; st < nb_states; ++st){
+      if(table.isFinal(st)) minimal.final_states.insert(label[blocks.sidx[st]]);
+    }
+    for(std::size_t lbl = 0; lbl < representatives.size(); ++lbl){
+      for(auto symbol : minimal.al){
+        const int to = *table.successors(representatives[lbl], symbol).begin();
+        minimal.tr.emplace_hint(minimal.tr.end(),
+          std::make_pair(static_cast<int>(lbl + 1), symbol), std::set<int>{label[blocks.sidx[to]]});
+      }
+    }
+
+    return minimal_hopcroft;
+  }
+
+  Automaton Automaton::createMinimalValmari(const Automaton& other, bool add_sink) {
+    return createMinimalValmari(fa::Automaton(other), add_sink);
+  }
+
+  Automaton Automaton::createMinimalValmari(Automaton&& other, bool add_sink) {
+    assert(other.isValid());
+    // Accessible, deterministic and co-accessible, without completion
+    fa::Automaton _other = std::move(other);
+
+    _other.removeNonAccessibleStates();
+    _other = createDeterministic(std::move(_other));
+
+    fa::Automaton minimal_valmari;
+    Data& minimal = minimal_valmari.mut();
+    minimal.al = _other.getAl();
+
+    if(_other.isLanguageEmpty()){
+      // A single initial state, which is the sink if one is asked
+      minimal.states.insert(1);
+      minimal.initial_states.insert(1);
+      if(add_sink){
+        for(auto symbol : minimal.al){
+          minimal.tr.emplace_hint(minimal.tr.end(), std::make_pair(1, symbol), std::set<int>{1});
+        }
+      }
+      return minimal_valmari;
+    }
+    _other.removeNonCoAccessibleStates();
+
+    const TransitionTable table(_other);
+    const std::size_t nb_states = table.countStates();
+
+    // Transitions as (tail, label, head), the label being the column
+    std::vector<int> tails, labels, heads;
+    for(std::size_t st = 0; st < nb_states; ++st){
+      for(std::size_t cell = table.firstCell(st); cell < table.firstCell(st + 1); ++cell){
+        const std::size_t column = table.cellColumn(cell);
+        if(column == 0) continue;
+        for(auto to : table.cellTargets(cell)){
+          tails.push_back(static_cast<int>(st));
+          labels.push_back(static_cast<int>(column));
+          heads.push_back(to);
+        }
+      }
+    }
+    const std::size_t nb_transitions = tails.size();
+
+    Partition blocks(nb_states);
+    Partition cords(nb_transitions);
+
+    // Cords start grouped by label
+    if(nb_transitions > 0){
+      std::stable_sort(cords.elems.begin(), cords.elems.end(), [&labels](int lhs, int rhs){
+        return labels[lhs] < labels[rhs];
+      });
+      cords.sets = 0;
+      int label = labels[cords.elems[0]];
+      for(std::size_t i = 0; i < nb_transitions; ++i){
+        const int t = cords.elems[i];
+        if(labels[t] != label){
+          label = labels[t];
+          cords.past[cords.sets++] = i;
+          cords.first[cords.sets] = i;
+        }
+        cords.sidx[t] = static_cast<int>(cords.sets);
+        cords.loc[t] = i;
+      }
+      cords.past[cords.sets++] = nb_transitions;
+    }
+
+    // Blocks start split between final and non-final states
+    for(std::size_t st = 0; st < nb_states; ++st){
+      if(table.isFinal(st)) blocks.mark(static_cast<int>(st));
+    }
+    blocks.split();
+
+    // Incoming transitions of every state
+    std::vector<std::size_t> in_offsets(nb_states + 1, 0);
+    for(auto to : heads) ++in_offsets[to + 1];
+    for(std::size_t st = 1; st <= nb_states; ++st) in_offsets[st] += in_offsets[st - 1];
+    std::vector<int> incoming(nb_transitions);
+    {
+      std::vector<std::size_t> fill(in_offsets.begin(), in_offsets.end() - 1);
+      for(std::size_t t = 0; t < nb_transitions; ++t) incoming[fill[heads[t]]++] = static_cast<int>(t);
+    }
+
+    // Every cord splits the blocks by their tails, every new block splits the
+    // cords by their heads (the first block never needs to)
+    std::size_t b = 1;
+    for(std::size_t c = 0; c < cords.sets; ++c){
+      for(std::size_t i = cords.first[c]; i < cords.past[c]; ++i){
+        blocks.mark(tails[cords.elems[i]]);
+      }
+      blocks.split();
+      for(; b < blocks.sets; ++b){
+        for(std::size_t i = blocks.first[b]; i < blocks.past[b]; ++i){
+          const int st = blocks.elems[i];
+          for(std::size_t j = in_offsets[st]; j < in_offsets[st + 1]; ++j){
+            cords.mark(incoming[j]);
+          }
+        }
+        cords.split();
+      }
+    }
+
+    // Blocks are numbered from 1 in the order of their first state
+    std::vector<int> label(blocks.sets, 0);
+    std::vector<std::size_t> representatives;
+    for(std::size_t st = 0; st < nb_states; ++st){
+      if(label[blocks.sidx[st]] == 0){
+        representatives.push_back(st);
+        label[blocks.sidx[st]] = static_cast<int>(representatives.size());
+      }
+    }
+    const int sink = static_cast<int>(representatives.size()) + 1;
+    bool sink_used = false;
+
+    for(std::size_t lbl = 1; lbl <= representatives.size(); ++lbl){
+      minimal.states.insert(minimal.states.end(), static_cast<int>(lbl));
+    }
+    for(auto st : table.initialStates()){
+      minimal.initial_states.insert(label[blocks.sidx[st]]);
+    }
+    for(std::size_t st = 0; st < nb_states; ++st){
+      if(table.isFinal(st)) minimal.final_states.insert(label[blocks.sidx[st]]);
+    }
+    for(std::size_t lbl = 0; lbl < representatives.size(); ++lbl){
+      for(auto symbol : minimal.al){
+        auto to = table.successors(representatives[lbl], symbol);
+        if(to.empty() && !add_sink) continue;
+        const int target = to.empty() ? sink : label[blocks.sidx[*to.begin()]];
+        sink_used = sink_used || to.empty();
+        minimal.tr.emplace_hint(minimal.tr.end(),
+          std::make_pair(static_cast<int>(lbl + 1), symbol), std::set<int>{target});
+      }
+    }
+    if(sink_used){
+      minimal.states.insert(minimal.states.end(), sink);
+      for(auto symbol : minimal.al){
+        minimal.tr.emplace_hint(minimal.tr.end(), std::make_pair(sink, symbol), std::set<int>{sink});
+      }
+    }
+
+    return minimal_valmari;
+  }
+
+  Automaton Automaton::createMinimalBrzozowski(const Automaton& other) {
+    assert(other.isValid());
+
+    fa::Automaton minimal_Brzozozzzozzozozzwwkswski = other;
+
+    minimal_Brzozozzzozzozozzwwkswski.makeMirror();
+    minimal_Brzozozzzozzozozzwwkswski = createDeterministic(std::move(minimal_Brzozozzzozzozozzwwkswski));
+    minimal_Brzozozzzozzozozzwwkswski.makeMirror();
+    minimal_Brzozozzzozzozozzwwkswski = createDeterministic(std::move(minimal_Brzozozzzozzozozzwwkswski));
+    minimal_Brzozozzzozzozozzwwkswski.makeComplete();
 
     return minimal_Brzozozzzozzozozzwwkswski;
   }
 
-}
+  /***************************** */
+  /*       AutomatonBuilder      */
+  /***************************** */
+
+  std::set<int> AutomatonBuilder::toSet(std::vector<int>& list) {
+    std::sort(list.begin(), list.end());
+    // Sorted input, the set is filled in linear time
+    return std::set<int>(list.begin(), std::unique(list.begin(), list.end()));
+  }
+
+  bool AutomatonBuilder::isValidSymbol(char symbol) {
+    return std::isgraph(symbol) != 0 && symbol != fa::Epsilon;
+  }
+
+  void AutomatonBuilder::reserve(std::size_t nb_edges) {
+    edges.reserve(nb_edges);
+  }
+
+  bool AutomatonBuilder::addSymbol(char symbol) {
+    if(!isValidSymbol(symbol)) return false;
+    al.insert(symbol);
+    return true;
+  }
+
+  bool AutomatonBuilder::addState(int state) {
+    if(state < 0) return false;
+    states.push_back(state);
+    return true;
+  }
+
+  bool AutomatonBuilder::setStateInitial(int state) {
+    if(!addState(state)) return false;
+    initial_states.push_back(state);
+    return true;
+  }
+
+  bool AutomatonBuilder::setStateFinal(int state) {
+    if(!addState(state)) return false;
+    final_states.push_back(state);
+    return true;
+  }
+
+  bool AutomatonBuilder::addTransition(int from, char symbol, int to) {
+    if(from < 0 || to < 0 || (symbol != fa::Epsilon && !isValidSymbol(symbol))){
+      return false;
+    }
+    edges.push_back({from, symbol, to});
+    return true;
+  }
+
+  bool AutomatonBuilder::addTransitions(const std::vector<Edge>& list) {
+    bool all = true;
+    edges.reserve(edges.size() + list.size());
+    for(const auto& e : list){
+      if(!addTransition(e.from, e.symbol, e.to)) all = false;
+    }
+    return all;
+  }
+
+  Automaton AutomatonBuilder::build() {
+    // Same order as the keys of the transition map, then the target
+    std::sort(edges.begin(), edges.end(), [](const Edge& lhs, const Edge& rhs){
+      if(lhs.from != rhs.from) return lhs.from < rhs.from;
+      if(lhs.symbol != rhs.symbol) return lhs.symbol < rhs.symbol;
+      return lhs.to < rhs.to;
+    });
+    edges.erase(std::unique(edges.begin(), edges.end(), [](const Edge& lhs, const Edge& rhs){
+      return lhs.from == rhs.from && lhs.symbol == rhs.symbol && lhs.to == rhs.to;
+    }), edges.end());
+
+    Automaton automaton;
+    Automaton::Data& data = automaton.mut();
+
+    std::vector<int> targets;
+    for(std::size_t first = 0; first < edges.size();){
+      const int from = edges[first].from;
+      const char symbol = edges[first].symbol;
+      std::size_t last = first;
+      targets.clear();
+      for(; last < edges.size() && edges[last].from == from && edges[last].symbol == symbol; ++last){
+        targets.push_back(edges[last].to);
+      }
+      // Targets are already sorted, both inserts are at the end
+      data.tr.emplace_hint(data.tr.end(), std::make_pair(from, symbol),
+                           std::set<int>(targets.begin(), targets.end()));
+      states.push_back(from);
+      states.insert(states.end(), targets.begin(), targets.end());
+      if(symbol != fa::Epsilon) al.insert(symbol);
+      first = last;
+    }
+
+    data.al = al;
+    data.states = toSet(states);
+    data.initial_states = toSet(initial_states);
+    data.final_states = toSet(final_states);
+
+    *this = AutomatonBuilder();
+    return automaton;
+  }
+
+  /***************************** */
+  /*          SymbolSet          */
+  /***************************** */
+
+  SymbolSet::SymbolSet(const std::set<char>& symbols) {
+    for(auto symbol : symbols){
+      insert(symbol);
+    }
+  }
+
+  bool SymbolSet::insert(char symbol) {
+    if(contains(symbol)) return false;
+    int bit = bitOf(symbol);
+    bits[bit >> 6] |= std::uint64_t(1) << (bit & 63);
+    return true;
+  }
+
+  bool SymbolSet::erase(char symbol) {
+    if(!contains(symbol)) return false;
+    int bit = bitOf(symbol);
+    bits[bit >> 6] &= ~(std::uint64_t(1) << (bit & 63));
+    return true;
+  }
+
+  std::size_t SymbolSet::size() const {
+    std::size_t res = 0;
+    for(auto word : bits){
+      res += static_cast<std::size_t>(__builtin_popcountll(word));
+    }
+    return res;
+  }
+
+  bool SymbolSet::empty() const {
+    return (bits[0] | bits[1] | bits[2] | bits[3]) == 0;
+  }
+
+  std::size_t SymbolSet::rank(char symbol) const {
+    int bit = bitOf(symbol);
+    std::size_t res = 0;
+    for(int w = 0; w < (bit >> 6); ++w){
+      res += static_cast<std::size_t>(__builtin_popcountll(bits[w]));
+    }
+    std::uint64_t below = (std::uint64_t(1) << (bit & 63)) - 1;
+    return res + static_cast<std::size_t>(__builtin_popcountll(bits[bit >> 6] & below));
+  }
+
+  SymbolSet SymbolSet::operator&(const SymbolSet& other) const {
+    SymbolSet res;
+    for(int w = 0; w < 4; ++w){
+      res.bits[w] = bits[w] & other.bits[w];
+    }
+    return res;
+  }
+
+  std::set<char> SymbolSet::toSet() const {
+    std::set<char> res;
+    for(auto symbol : *this){
+      res.insert(res.end(), symbol);
+    }
+    return res;
+  }
+
+  int SymbolSet::nextBit(int from) const {
+    for(int w = from >> 6; w < 4 && from < 256; ++w){
+      std::uint64_t word = bits[w];
+      if(w == (from >> 6)) word &= ~std::uint64_t(0) << (from & 63);
+      if(word != 0) return (w << 6) | __builtin_ctzll(word);
+    }
+    return 256;
+  }
+
+  /***************************** */
+  /*         StateIndex          */
+  /***************************** */
+
+  StateIndex::StateIndex(const std::set<int>& states)
+  : ids(states.begin(), states.end())
+  {
+    // States are non-negative, a direct table is used as long as it is not
+    // much bigger than the states themselves
+    if(!ids.empty() && static_cast<std::size_t>(ids.back()) < 2 * ids.size() + 64){
+      direct.assign(static_cast<std::size_t>(ids.back()) + 1, -1);
+      for(std::size_t i = 0; i < ids.size(); ++i){
+        direct[ids[i]] = static_cast<int>(i);
+      }
+    }
+  }
+
+  int StateIndex::indexOf(int state) const {
+    if(!direct.empty()){
+      if(state < 0 || static_cast<std::size_t>(state) >= direct.size()) return -1;
+      return direct[state];
+    }
+    auto find = std::lower_bound(ids.begin(), ids.end(), state);
+    if(find == ids.end() || *find != state) return -1;
+    return static_cast<int>(find - ids.begin());
+  }
+
+  /***************************** */
+  /*       TransitionTable       */
+  /***************************** */
+
+  TransitionTable::TransitionTable(const Automaton& automaton)
+  : interned(automaton.d->states)
+  {
+    columns.fill(-1);
+    symbols.push_back(fa::Epsilon);
+    columns[static_cast<unsigned char>(fa::Epsilon)] = 0;
+    for(auto symbol : automaton.d->al){
+      columns[static_cast<unsigned char>(symbol)] = static_cast<int>(symbols.size());
+      symbols.push_back(symbol);
+    }
+
+    // The keys of the map come grouped by state, in increasing order, and
+    // the symbols of a state in column order. Epsilon is taken first so it
+    // stays column 0 whatever the sign of char. Transitions involving an
+    // unknown state or symbol are dropped, as well as the cells left empty.
+    const auto& tr = automaton.d->tr;
+    auto addCell = [&](int column, const std::set<int>& to_states){
+      for(auto to : to_states){
+        int to_index = indexOf(to);
+        if(to_index >= 0) targets.push_back(to_index);
+      }
+      if(targets.size() == offsets.back()) return;
+      assert(targets.size() <= std::numeric_limits<std::uint32_t>::max());
+      cells.push_back(static_cast<std::uint16_t>(column));
+      offsets.push_back(static_cast<std::uint32_t>(targets.size()));
+    };
+
+    rows.assign(interned.size() + 1, 0);
+    offsets.push_back(0);
+    std::size_t row = 0;
+    for(auto first = tr.begin(); first != tr.end();){
+      const int state = first->first.first;
+      auto last = first;
+      while(last != tr.end() && last->first.first == state) ++last;
+
+      int from = indexOf(state);
+      if(from >= 0){
+        while(row <= static_cast<std::size_t>(from)) rows[row++] = static_cast<std::uint32_t>(cells.size());
+        auto epsilon = tr.find({state, fa::Epsilon});
+        if(epsilon != tr.end()) addCell(0, epsilon->second);
+        for(auto t = first; t != last; ++t){
+          int column = columnOf(t->first.second);
+          if(column > 0) addCell(column, t->second);
+        }
+      }
+      first = last;
+    }
+    while(row < rows.size()) rows[row++] = static_cast<std::uint32_t>(cells.size());
+
+    for(auto st : automaton.d->initial_states){
+      int st_index = indexOf(st);
+      if(st_index >= 0) initials.push_back(st_index);
+    }
+    finals.assign(interned.size(), 0);
+    for(auto st : automaton.d->final_states){
+      int st_index = indexOf(st);
+      if(st_index >= 0) finals[st_index] = 1;
+    }
+  }
+
+  std::size_t TransitionTable::countStates() const {
+    return interned.size();
+  }
+
+  std::size_t TransitionTable::countColumns() const {
+    return symbols.size();
+  }
+
+  int TransitionTable::indexOf(int state) const {
+    return interned.indexOf(state);
+  }
+
+  int TransitionTable::stateAt(std::size_t st_index) const {
+    return interned.stateAt(st_index);
+  }
+
+  int TransitionTable::columnOf(char symbol) const {
+    return columns[static_cast<unsigned char>(symbol)];
+  }
+
+  char TransitionTable::symbolAt(std::size_t column) const {
+    return symbols[column];
+  }
+
+  TransitionTable::Range TransitionTable::successors(std::size_t index, char symbol) const {
+    int column = columnOf(symbol);
+    if(column < 0){
+      return Range{nullptr, nullptr};
+    }
+    return successorsAt(index, static_cast<std::size_t>(column));
+  }
+
+  TransitionTable::Range TransitionTable::successorsAt(std::size_t index, std::size_t column) const {
+    const auto first = cells.begin() + rows[index];
+    const auto last = cells.begin() + rows[index + 1];
+    const auto cell = std::lower_bound(first, last, column);
+    if(cell == last || *cell != column){
+      return Range{nullptr, nullptr};
+    }
+    return cellTargets(static_cast<std::size_t>(cell - cells.begin()));
+  }
+
+  const std::vector<int>& TransitionTable::initialStates() const {
+    return initials;
+  }
+
+  bool TransitionTable::isFinal(std::size_t index) const {
+    return finals[index] != 0;
+  }
+
+  /***************************** */
+  /*        SymbolClasses        */
+  /***************************** */
+
+  SymbolClasses::SymbolClasses()
+  : representatives{fa::Epsilon}
+  {
+    classes.fill(0);
+  }
+
+  SymbolClasses::SymbolClasses(const Automaton& automaton)
+  : SymbolClasses()
+  {
+    // Signature of a symbol: the sequence of (state, targets...) it labels, in
+    // the order of the transition map. Equal signatures mean equal columns.
+    std::array<std::vector<int>, 256> signatures;
+    for(const auto& t : automaton.d->tr){
+      const char symbol = t.first.second;
+      if(symbol == fa::Epsilon || !automaton.d->al.contains(symbol)) continue;
+      auto& signature = signatures[static_cast<unsigned char>(symbol)];
+      signature.push_back(t.first.first);
+      signature.insert(signature.end(), t.second.begin(), t.second.end());
+      signature.push_back(-1);
+    }
+
+    std::map<std::vector<int>, std::uint8_t> known;
+    for(auto symbol : automaton.d->al){
+      if(symbol == fa::Epsilon) continue;
+      auto& signature = signatures[static_cast<unsigned char>(symbol)];
+      auto find = known.find(signature);
+      if(find == known.end()){
+        assert(representatives.size() < 256);
+        find = known.insert({std::move(signature), static_cast<std::uint8_t>(representatives.size())}).first;
+        representatives.push_back(symbol);
+      }
+      classes[static_cast<unsigned char>(symbol)] = find->second;
+    }
+  }
+
+  /***************************** */
+  /*         CompiledDfa         */
+  /***************************** */
+
+  CompiledDfa::CompiledDfa(const Automaton& automaton)
+  : classes(automaton),
+    width(classes.countClasses()),
+    initial(Dead)
+  {
+    const TransitionTable transitions(automaton);
+    assert(transitions.initialStates().size() <= 1);
+
+    if(!transitions.initialStates().empty()){
+      initial = transitions.initialStates().front();
+    }
+
+    // Column 0 (bytes outside the alphabet) stays Dead
+    const std::size_t n = transitions.countStates();
+    table.assign(n * width, Dead);
+    finals.assign(n, 0);
+    for(std::size_t st = 0; st < n; ++st){
+      finals[st] = transitions.isFinal(st);
+      for(std::size_t cls = 1; cls < width; ++cls){
+        auto to = transitions.successors(st, classes.representative(cls));
+        assert(to.size() <= 1);
+        if(!to.empty()){
+          table[st * width + cls] = *to.begin();
+        }
+      }
+    }
+  }
+
+  std::size_t CompiledDfa::countStates() const {
+    return finals.size();
+  }
+
+  std::size_t CompiledDfa::countClasses() const {
+    return width;
+  }
+
+  int CompiledDfa::initialState() const {
+    return initial;
+  }
+
+  bool CompiledDfa::isFinal(int state) const {
+    return state != Dead && finals[state] != 0;
+  }
 
+  bool CompiledDfa::match(const std::string& word) const {
+    return match(word.data(), word.size());
+  }
+
+  bool CompiledDfa::match(const char* data, std::size_t length) const {
+    int st = initial;
+    if(st == Dead) return false;
+
+    const int* rows = table.data();
+    const std::uint8_t* columns = classes.table().data();
+    for(std::size_t i = 0; i < length; ++i){
+      st = rows[static_cast<std::size_t>(st) * width + columns[static_cast<unsigned char>(data[i])]];
+      if(st == Dead) return false;
+    }
+
+    return finals[st] != 0;
+  }
+
+  /***************************** */
+  /*           StateSet          */
+  /***************************** */
+
+  StateSet::StateSet(std::size_t size)
+  : n(size), bits((size + 63) >> 6, 0)
+  {}
+
+  void StateSet::resize(std::size_t size) {
+    n = size;
+    bits.assign((size + 63) >> 6, 0);
+  }
+
+  void StateSet::clear() {
+    std::fill(bits.begin(), bits.end(), 0);
+  }
+
+  bool StateSet::empty() const {
+    for(auto word : bits){
+      if(word != 0) return false;
+    }
+    return true;
+  }
+
+  std::size_t StateSet::count() const {
+    std::size_t res = 0;
+    for(auto word : bits){
+      res += static_cast<std::size_t>(__builtin_popcountll(word));
+    }
+    return res;
+  }
+
+  void StateSet::merge(const StateSet& other) {
+    assert(other.bits.size() == bits.size());
+    for(std::size_t w = 0; w < bits.size(); ++w){
+      bits[w] |= other.bits[w];
+    }
+  }
+
+  bool StateSet::intersects(const StateSet& other) const {
+    assert(other.bits.size() == bits.size());
+    for(std::size_t w = 0; w < bits.size(); ++w){
+      if(bits[w] & other.bits[w]) return true;
+    }
+    return false;
+  }
+
+  /***************************** */
+  /*       EpsilonClosures       */
+  /***************************** */
+
+  EpsilonClosures::EpsilonClosures(const TransitionTable& table)
+  : component(table.countStates(), -1),
+    offsets(1, 0)
+  {
+    const std::size_t n = table.countStates();
+    for(std::size_t st = 0; st < n && !has_epsilon; ++st){
+      has_epsilon = !table.successorsAt(st, 0).empty();
+    }
+    if(!has_epsilon){
+      // Every state is its own closure
+      members.resize(n);
+      offsets.resize(n + 1);
+      for(std::size_t st = 0; st < n; ++st){
+        component[st] = static_cast<int>(st);
+        members[st] = static_cast<int>(st);
+        offsets[st + 1] = st + 1;
+      }
+      return;
+    }
+
+    // Iterative Tarjan on the epsilon transitions: components are completed
+    // after every component they reach, so their closures are known
+    std::vector<int> order(n, -1);
+    std::vector<int> low(n, 0);
+    std::vector<int> scc_stack;
+    std::vector<std::pair<int, const int*>> call_stack;
+    std::vector<char> marks(n, 0);
+    std::vector<int> gathered;
+    int counter = 0;
+    int nb_components = 0;
+
+    for(std::size_t root = 0; root < n; ++root){
+      if(order[root] >= 0) continue;
+      call_stack.push_back({static_cast<int>(root), table.successorsAt(root, 0).begin()});
+      order[root] = low[root] = counter++;
+      scc_stack.push_back(static_cast<int>(root));
+
+      while(!call_stack.empty()){
+        const int st = call_stack.back().first;
+        const int*& it = call_stack.back().second;
+        const auto successors = table.successorsAt(static_cast<std::size_t>(st), 0);
+        if(it != successors.end()){
+          const int to = *it++;
+          if(order[to] < 0){
+            order[to] = low[to] = counter++;
+            scc_stack.push_back(to);
+            call_stack.push_back({to, table.successorsAt(static_cast<std::size_t>(to), 0).begin()});
+          }else if(component[to] < 0){
+            // Still on the stack
+            low[st] = std::min(low[st], order[to]);
+          }
+          continue;
+        }
+
+        call_stack.pop_back();
+        if(!call_stack.empty()){
+          const int parent = call_stack.back().first;
+          low[parent] = std::min(low[parent], low[st]);
+        }
+        if(low[st] != order[st]) continue;
+
+        // st is the root of a component, its states are on top of the stack
+        const int cmp = nb_components++;
+        gathered.clear();
+        std::size_t top = scc_stack.size();
+        do {
+          --top;
+          component[scc_stack[top]] = cmp;
+        } while(scc_stack[top] != st);
+        for(std::size_t i = top; i < scc_stack.size(); ++i){
+          const int member = scc_stack[i];
+          if(!marks[member]){
+            marks[member] = 1;
+            gathered.push_back(member);
+          }
+          for(auto to : table.successorsAt(static_cast<std::size_t>(member), 0)){
+            if(component[to] == cmp) continue;
+            // Other components reached are already complete
+            const std::size_t other = static_cast<std::size_t>(component[to]);
+            for(std::size_t m = offsets[other]; m < offsets[other + 1]; ++m){
+              if(!marks[members[m]]){
+                marks[members[m]] = 1;
+                gathered.push_back(members[m]);
+              }
+            }
+          }
+        }
+        scc_stack.resize(top);
+        for(auto member : gathered) marks[member] = 0;
+        std::sort(gathered.begin(), gathered.end());
+        members.insert(members.end(), gathered.begin(), gathered.end());
+        offsets.push_back(members.size());
+      }
+    }
+  }
+
+  std::vector<int> EpsilonClosures::closure(const std::vector<int>& states) const {
+    std::vector<int> res;
+    for(auto st : states){
+      const auto range = closure(static_cast<std::size_t>(st));
+      res.insert(res.end(), range.begin(), range.end());
+    }
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
+    return res;
+  }
+
+  void EpsilonClosures::closure(TransitionTable::Range states, std::vector<int>& out) const {
+    out.clear();
+    for(auto st : states){
+      const auto range = closure(static_cast<std::size_t>(st));
+      out.insert(out.end(), range.begin(), range.end());
+    }
+  }
+
+  void EpsilonClosures::close(StateSet& states) const {
+    if(!has_epsilon) return;
+    // Closures are closed, the ones of the added states are not needed
+    const StateSet origin = states;
+    origin.forEach([&](std::size_t st){
+      for(auto to : closure(st)) states.insert(static_cast<std::size_t>(to));
+    });
+  }
+
+  std::uint64_t EpsilonClosures::closedSuccessors(TransitionTable::Range from, const TransitionTable& table,
+                                                  std::size_t column, std::vector<char>& marks,
+                                                  std::vector<int>& out) const {
+    const std::size_t first = out.size();
+    std::uint64_t hash = 0;
+    for(auto st_from : from){
+      for(auto st_to : table.successorsAt(static_cast<std::size_t>(st_from), column)){
+        for(auto reached : closure(static_cast<std::size_t>(st_to))){
+          if(!marks[reached]){
+            marks[reached] = 1;
+            out.push_back(reached);
+            hash += SubsetTable::hashOf(reached);
+          }
+        }
+      }
+    }
+    for(std::size_t i = first; i < out.size(); ++i) marks[out[i]] = 0;
+    std::sort(out.begin() + first, out.end());
+    return hash;
+  }
+
+  /***************************** */
+  /*         SubsetTable         */
+  /***************************** */
+
+  SubsetTable::SubsetTable()
+  : offsets(1, 0), slots(16, -1)
+  {}
+
+  std::uint64_t SubsetTable::hashOf(const std::vector<int>& subset) {
+    std::uint64_t hash = 0;
+    for(auto st : subset) hash += hashOf(st);
+    return hash;
+  }
+
+  bool SubsetTable::equals(std::size_t id, const int* first, const int* last) const {
+    const std::size_t begin = offsets[id];
+    return offsets[id + 1] - begin == static_cast<std::size_t>(last - first)
+      && std::equal(first, last, elems.begin() + begin);
+  }
+
+  int SubsetTable::find(const int* first, const int* last, std::uint64_t hash) const {
+    const std::size_t mask = slots.size() - 1;
+    for(std::size_t slot = hash & mask; slots[slot] >= 0; slot = (slot + 1) & mask){
+      const std::size_t id = static_cast<std::size_t>(slots[slot]);
+      if(hashes[id] == hash && equals(id, first, last)) return slots[slot];
+    }
+    return -1;
+  }
+
+  std::pair<int, bool> SubsetTable::insert(const int* first, const int* last, std::uint64_t hash) {
+    const std::size_t mask = slots.size() - 1;
+    std::size_t slot = hash & mask;
+    for(; slots[slot] >= 0; slot = (slot + 1) & mask){
+      const std::size_t id = static_cast<std::size_t>(slots[slot]);
+      if(hashes[id] == hash && equals(id, first, last)) return {slots[slot], false};
+    }
+
+    const int id = static_cast<int>(hashes.size());
+    elems.insert(elems.end(), first, last);
+    offsets.push_back(elems.size());
+    hashes.push_back(hash);
+    slots[slot] = id;
+
+    // Load factor kept under 1/2
+    if(2 * hashes.size() > slots.size()) grow();
+    return {id, true};
+  }
+
+  void SubsetTable::grow() {
+    slots.assign(2 * slots.size(), -1);
+    const std::size_t mask = slots.size() - 1;
+    for(std::size_t id = 0; id < hashes.size(); ++id){
+      std::size_t slot = hashes[id] & mask;
+      while(slots[slot] >= 0) slot = (slot + 1) & mask;
+      slots[slot] = static_cast<int>(id);
+    }
+  }
+
+  TransitionTable::Range SubsetTable::subset(std::size_t id) const {
+    return {elems.data() + offsets[id], elems.data() + offsets[id + 1]};
+  }
+
+  std::size_t SubsetTable::memoryUsage() const {
+    return elems.capacity() * sizeof(int) + offsets.capacity() * sizeof(std::size_t)
+      + hashes.capacity() * sizeof(std::uint64_t) + slots.capacity() * sizeof(int);
+  }
+
+  void SubsetTable::clear() {
+    *this = SubsetTable();
+  }
+
+  /***************************** */
+  /*        NfaSimulator         */
+  /***************************** */
+
+  NfaSimulator::NfaSimulator(const Automaton& automaton, bool precompute_masks)
+  : transitions(automaton),
+    closures(transitions),
+    initials(transitions.countStates()),
+    finals(transitions.countStates()),
+    words((transitions.countStates() + 63) >> 6)
+  {
+    const std::size_t n = transitions.countStates();
+    for(auto st : transitions.initialStates()){
+      initials.insert(st);
+    }
+    closures.close(initials);
+    for(std::size_t st = 0; st < n; ++st){
+      if(transitions.isFinal(st)) finals.insert(st);
+    }
+
+    if(!precompute_masks || n == 0){
+      return;
+    }
+
+    // One block of masks per class of the alphabet (class 0 has no successor)
+    classes = SymbolClasses(automaton);
+    const std::size_t blocks = classes.countClasses() - 1;
+    if(blocks * n * words > MaskBudget){
+      return;
+    }
+
+    masks.assign(blocks * n * words, 0);
+    for(std::size_t block = 0; block < blocks; ++block){
+      const char symbol = classes.representative(block + 1);
+      for(std::size_t st = 0; st < n; ++st){
+        std::uint64_t* mask = masks.data() + (block * n + st) * words;
+        // Masks hold the closures of the successors
+        for(auto to : transitions.successors(st, symbol)){
+          for(auto reached : closures.closure(static_cast<std::size_t>(to))){
+            mask[reached >> 6] |= std::uint64_t(1) << (reached & 63);
+          }
+        }
+      }
+    }
+  }
+
+  std::size_t NfaSimulator::countStates() const {
+    return transitions.countStates();
+  }
+
+  const TransitionTable& NfaSimulator::table() const {
+    return transitions;
+  }
+
+  bool NfaSimulator::hasMasks() const {
+    return !masks.empty();
+  }
+
+  void NfaSimulator::start(StateSet& current) const {
+    current = initials;
+  }
+
+  void NfaSimulator::step(const StateSet& current, char symbol, StateSet& next) const {
+    next.clear();
+
+    if(hasMasks()){
+      const std::size_t cls = classes.classOf(symbol);
+      if(cls == 0) return;
+      const std::size_t n = transitions.countStates();
+      const std::uint64_t* block = masks.data() + (cls - 1) * n * words;
+      std::uint64_t* out = next.words().data();
+      current.forEach([&](std::size_t st){
+        const std::uint64_t* mask = block + st * words;
+        for(std::size_t w = 0; w < words; ++w){
+          out[w] |= mask[w];
+        }
+      });
+    }else{
+      const int column = transitions.columnOf(symbol);
+      if(column < 0 || symbol == fa::Epsilon) return;
+      current.forEach([&](std::size_t st){
+        for(auto to : transitions.successorsAt(st, static_cast<std::size_t>(column))){
+          for(auto reached : closures.closure(static_cast<std::size_t>(to))){
+            next.insert(static_cast<std::size_t>(reached));
+          }
+        }
+      });
+    }
+  }
+
+  bool NfaSimulator::isAccepting(const StateSet& current) const {
+    return current.intersects(finals);
+  }
+
+  bool NfaSimulator::match(const std::string& word) const {
+    StateSet current(countStates());
+    StateSet next(countStates());
+    return match(word.data(), word.size(), current, next);
+  }
+
+  bool NfaSimulator::match(const char* data, std::size_t length, StateSet& current, StateSet& next) const {
+    start(current);
+    for(std::size_t i = 0; i < length; ++i){
+      step(current, data[i], next);
+      std::swap(current, next);
+      if(current.empty()) return false;
+    }
+
+    return isAccepting(current);
+  }
+
+  /***************************** */
+  /*           LazyDfa           */
+  /***************************** */
+
+  LazyDfa::LazyDfa(const Automaton& automaton, std::size_t budget)
+  : transitions(automaton),
+    closures(transitions),
+    classes(automaton),
+    width(classes.countClasses()),
+    budget(budget),
+    in_arrival(transitions.countStates(), 0)
+  {}
+
+  int LazyDfa::intern(std::uint64_t hash) {
+    if(arrival.empty()) return Dead;
+    auto res = subsets.insert(arrival, hash);
+    if(res.second){
+      // Column 0 (bytes outside the alphabet) is Dead
+      table.resize(table.size() + width, Unknown);
+      table[static_cast<std::size_t>(res.first) * width] = Dead;
+      char final = 0;
+      for(auto st : arrival) final = final || transitions.isFinal(st);
+      finals.push_back(final);
+    }
+    return res.first;
+  }
+
+  void LazyDfa::flush() {
+    // The memory is released, the budget is measured on the capacities
+    subsets.clear();
+    std::vector<int>().swap(table);
+    std::vector<char>().swap(finals);
+    ++flushes;
+  }
+
+  int LazyDfa::start() {
+    arrival = closures.closure(transitions.initialStates());
+    return intern(SubsetTable::hashOf(arrival));
+  }
+
+  int LazyDfa::next(int state, char symbol) {
+    if(state == Dead) return Dead;
+    const std::size_t cls = classes.classOf(symbol);
+    const std::size_t cell = static_cast<std::size_t>(state) * width + cls;
+    if(table[cell] != Unknown) return table[cell];
+
+    // Subset reached by the first symbol of the class
+    const std::size_t column = static_cast<std::size_t>(transitions.columnOf(classes.representative(cls)));
+    arrival.clear();
+    const std::uint64_t hash = closures.closedSuccessors(subsets.subset(static_cast<std::size_t>(state)),
+                                                         transitions, column, in_arrival, arrival);
+
+    // Dead needs no new state, it is cached whatever the budget
+    if(arrival.empty()){
+      table[cell] = Dead;
+      return Dead;
+    }
+    if(memoryUsage() > budget && subsets.find(arrival, hash) < 0){
+      // Only the target is needed from now on, the transition is not cached
+      flush();
+      return intern(hash);
+    }
+    const int target = intern(hash);
+    table[cell] = target;
+    return target;
+  }
+
+  bool LazyDfa::isFinal(int state) const {
+    return state != Dead && finals[static_cast<std::size_t>(state)];
+  }
+
+  bool LazyDfa::match(const std::string& word) {
+    return match(word.data(), word.size());
+  }
+
+  bool LazyDfa::match(const char* data, std::size_t length) {
+    int state = start();
+    for(std::size_t i = 0; i < length && state != Dead; ++i){
+      state = next(state, data[i]);
+    }
+    return isFinal(state);
+  }
+
+  std::size_t LazyDfa::countStates() const {
+    return subsets.size();
+  }
+
+  std::size_t LazyDfa::countFlushes() const {
+    return flushes;
+  }
+
+  std::size_t LazyDfa::memoryUsage() const {
+    return subsets.memoryUsage() + table.capacity() * sizeof(int) + finals.capacity();
+  }
+
+  /***************************** */
+  /*           Matcher           */
+  /***************************** */
+
+  Matcher::Matcher(const Automaton& automaton)
+  : state(CompiledDfa::Dead)
+  {
+    if(automaton.isDeterministic()){
+      dfa = std::make_unique<CompiledDfa>(automaton);
+    }else{
+      simulator = std::make_unique<NfaSimulator>(automaton);
+      current.resize(simulator->countStates());
+      next.resize(simulator->countStates());
+    }
+    reset();
+  }
+
+  void Matcher::feed(const char* data, std::size_t length) {
+    if(dfa){
+      for(std::size_t i = 0; i < length && state != CompiledDfa::Dead; ++i){
+        state = dfa->next(state, data[i]);
+      }
+      return;
+    }
+
+    for(std::size_t i = 0; i < length && !current.empty(); ++i){
+      simulator->step(current, data[i], next);
+      std::swap(current, next);
+    }
+  }
+
+  bool Matcher::isAccepting() const {
+    if(dfa){
+      return state != CompiledDfa::Dead && dfa->isFinal(state);
+    }
+    return simulator->isAccepting(current);
+  }
+
+  bool Matcher::isDead() const {
+    if(dfa){
+      return state == CompiledDfa::Dead;
+    }
+    return current.empty();
+  }
+
+  void Matcher::reset() {
+    if(dfa){
+      state = dfa->initialState();
+    }else{
+      simulator->start(current);
+    }
+  }
+
+  /***************************** */
+  /*           Searcher          */
+  /***************************** */
+
+  Searcher::Searcher(const Automaton& automaton)
+  : forward(Automaton::createMinimalValmari(automaton))
+  , backward(Automaton::createDeterministic(createUnanchoredMirror(automaton)))
+  {}
+
+  Automaton Searcher::createUnanchoredMirror(const Automaton& automaton) {
+    assert(automaton.isValid());
+
+    Automaton mirror = Automaton::createMirror(automaton);
+    const int start = *mirror.getSt().rbegin() + 1;
+    const std::set<int> initials = mirror.getInitialSt();
+    mirror.addState(start);
+    for(char symbol : mirror.getAl()){
+      mirror.addTransition(start, symbol, start);
+    }
+    for(int state : initials){
+      mirror.addTransition(start, fa::Epsilon, state);
+      mirror.removeInitialState(state);
+    }
+    mirror.setStateInitial(start);
+    return mirror;
+  }
+
+  void Searcher::findStarts(std::string_view text, std::vector<char>& starts) const {
+    starts.assign(text.size() + 1, 0);
+    const int initial = backward.initialState();
+    if(initial == CompiledDfa::Dead) return;
+
+    int st = initial;
+    starts[text.size()] = backward.isFinal(st);
+    for(std::size_t i = text.size(); i-- > 0;){
+      st = backward.next(st, text[i]);
+      // Only a symbol out of the alphabet leaves the looping start state,
+      // no match goes through it
+      if(st == CompiledDfa::Dead) st = initial;
+      starts[i] = backward.isFinal(st);
+    }
+  }
+
+  std::size_t Searcher::findEnd(std::string_view text, std::size_t start, Kind kind) const {
+    int st = forward.initialState();
+    if(st != CompiledDfa::Dead && forward.isFinal(st) && kind == Kind::LeftmostFirst) return start;
+
+    std::size_t end = start;
+    for(std::size_t i = start; i < text.size() && st != CompiledDfa::Dead; ++i){
+      st = forward.next(st, text[i]);
+      if(st != CompiledDfa::Dead && forward.isFinal(st)){
+        end = i + 1;
+        if(kind == Kind::LeftmostFirst) break;
+      }
+    }
+    return end;
+  }
+
+  bool Searcher::find(std::string_view text, Match& match, Kind kind) const {
+    std::vector<char> starts;
+    findStarts(text, starts);
+    auto it = std::find(starts.begin(), starts.end(), 1);
+    if(it == starts.end()) return false;
+
+    match.start = static_cast<std::size_t>(it - starts.begin());
+    match.end = findEnd(text, match.start, kind);
+    return true;
+  }
+
+  std::vector<Searcher::Match> Searcher::findAll(std::string_view text, Kind kind) const {
+    std::vector<char> starts;
+    findStarts(text, starts);
+
+    std::vector<Match> matches;
+    std::size_t from = 0;
+    while(from <= text.size()){
+      auto it = std::find(starts.begin() + from, starts.end(), 1);
+      if(it == starts.end()) break;
+
+      Match match;
+      match.start = static_cast<std::size_t>(it - starts.begin());
+      match.end = findEnd(text, match.start, kind);
+      matches.push_back(match);
+      from = match.end > match.start ? match.end : match.end + 1;
+    }
+    return matches;
+  }
+
+  /***************************** */
+  /*          Traversal          */
+  /***************************** */
+
+  Traversal::Traversal(const TransitionTable& table)
+  : table(table), seen(table.countStates())
+  {}
+
+  void Traversal::reset() {
+    // Only the states of the previous run are set
+    for(auto st : queue){
+      seen.erase(st);
+    }
+    queue.clear();
+  }
+
+  bool Traversal::discover(int st) {
+    if(seen.contains(st)) return false;
+    seen.insert(st);
+    queue.push_back(st);
+    return true;
+  }
+
+  const std::vector<int>& Traversal::run(const std::vector<int>& sources) {
+    reset();
+    for(auto st : sources){
+      discover(st);
+    }
+    // The queue is the discovery order, head is the next state to expand
+    for(std::size_t head = 0; head < queue.size(); ++head){
+      for(auto to : table.rowTargets(static_cast<std::size_t>(queue[head]))){
+        discover(to);
+      }
+    }
+    return queue;
+  }
+
+  int Traversal::findFinal(const std::vector<int>& sources) {
+    reset();
+    for(auto st : sources){
+      if(discover(st) && table.isFinal(st)) return st;
+    }
+    for(std::size_t head = 0; head < queue.size(); ++head){
+      for(auto to : table.rowTargets(static_cast<std::size_t>(queue[head]))){
+        if(discover(to) && table.isFinal(to)) return to;
+      }
+    }
+    return -1;
+  }
+
+  const StateSet& Traversal::visited() const {
+    return seen;
+  }
+
+  const std::vector<int>& Traversal::order() const {
+    return queue;
+  }
+
+}
@@ -2,14 +2,19 @@
 #define AUTOMATON_H
 
 #include <cstddef>
+#include <cstdint>
 #include <iosfwd>
+#include <iterator>
+#include <limits>
 #include <set>
 #include <string>
 #include <array>
 #include <list>
 #include <ctype.h>
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
@@ -17,6 +22,92 @@ namespace fa {
 
   constexpr char Epsilon = '\0';
 
+  /**
+   * Set of symbols stored as a 256-bit bitmap.
+   *
+   * Iteration follows the order of std::set<char>, so replacing one by the
+   * other does not change the order in which algorithms visit symbols.
+   */
+  class SymbolSet {
+  public:
+    class const_iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = char;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const char*;
+      using reference = char;
+
+      const_iterator(const SymbolSet* set, int bit) : set(set), bit(bit) {}
+      char operator*() const { return SymbolSet::symbolOf(bit); }
+      const_iterator& operator++() { bit = set->nextBit(bit + 1); return *this; }
+      const_iterator operator++(int) { const_iterator it = *this; ++*this; return it; }
+      bool operator==(const const_iterator& other) const { return bit == other.bit; }
+      bool operator!=(const const_iterator& other) const { return bit != other.bit; }
+
+    private:
+      const SymbolSet* set;
+      int bit;
+    };
+
+    SymbolSet() = default;
+    SymbolSet(const std::set<char>& symbols);
+
+    /**
+     * Returns true if the symbol was effectively inserted / erased
+     */
+    bool insert(char symbol);
+    bool erase(char symbol);
+
+    bool contains(char symbol) const {
+      int bit = bitOf(symbol);
+      return (bits[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    std::size_t size() const;
+    bool empty() const;
+
+    /**
+     * Dense column of a symbol: the number of symbols of the set before it
+     */
+    std::size_t rank(char symbol) const;
+
+    const_iterator begin() const { return const_iterator(this, nextBit(0)); }
+    const_iterator end() const { return const_iterator(this, 256); }
+
+    /**
+     * Intersection of two sets
+     */
+    SymbolSet operator&(const SymbolSet& other) const;
+
+    bool operator==(const SymbolSet& other) const { return bits == other.bits; }
+    bool operator!=(const SymbolSet& other) const { return bits != other.bits; }
+
+    /**
+     * Copy as a std::set
+     */
+    std::set<char> toSet() const;
+    operator std::set<char>() const { return toSet(); }
+
+  private:
+    // Flipping the sign bit of signed chars makes bit order follow char order
+    static constexpr int Flip = std::numeric_limits<char>::is_signed ? 0x80 : 0;
+    static int bitOf(char symbol) { return static_cast<unsigned char>(symbol) ^ Flip; }
+    static char symbolOf(int bit) { return static_cast<char>(static_cast<unsigned char>(bit ^ Flip)); }
+
+    /**
+     * First bit set at or after from, 256 if there is none
+     */
+    int nextBit(int from) const;
+
+    std::array<std::uint64_t, 4> bits = {};
+  };
+
+  class TransitionTable;
+  class CompiledDfa;
+  class StateIndex;
+  class StateSet;
+
   class Automaton {
   public:
     /**
@@ -24,30 +115,50 @@ namespace fa {
      */
     Automaton();
 
+    /**
+     * Copies share their representation until one of them changes. A moved-from
+     * automaton is left empty.
+     */
+    Automaton(const Automaton& other) = default;
+    Automaton(Automaton&& other) noexcept;
+    Automaton& operator=(const Automaton& other) = default;
+    Automaton& operator=(Automaton&& other) noexcept;
+
     /***************************** */
     /*            MISC             */
     /***************************** */
 
-    /* Getters */
-    std::set<char> getAl() const;
-    std::set<int> getSt() const;
-    std::set<int> getInitialSt() const;
-    std::set<int> getFinalSt() const;
-    std::map<std::pair<int, char>, std::set<int>> getTr() const;
+    /* Getters, the references are invalidated by any change of the automaton */
+    const SymbolSet& getAl() const;
+    const std::set<int>& getSt() const;
+    const std::set<int>& getInitialSt() const;
+    const std::set<int>& getFinalSt() const;
+    const std::map<std::pair<int, char>, std::set<int>>& getTr() const;
     /* Setters */
-    void setAl(std::set<char> _al);
-    void setSt(std::set<int> _st);
-    void setInitSt(std::set<int> _init_st);
-    void setFinalSt(std::set<int> _final_st);
-    void setTr(std::map<std::pair<int, char>, std::set<int>> _tr);
+    void setAl(const std::set<char>& _al);
+    void setAl(const SymbolSet& _al);
+    void setSt(const std::set<int>& _st);
+    void setInitSt(const std::set<int>& _init_st);
+    void setFinalSt(const std::set<int>& _final_st);
+    void setTr(const std::map<std::pair<int, char>, std::set<int>>& _tr);
     /* Remove functions for initial and final states sets */
     void removeFinalState(int state);
     void removeInitialState(int state);
     /* Copy */
     void copy(const Automaton& other);
+    /**
+     * Maintain an index of the predecessors of every state
+     *
+     * Disabled by default. When enabled, it is updated by every change of the
+     * transitions so that removeState and removeNonCoAccessibleStates only
+     * touch the transitions of the states involved.
+     */
+    void setPredecessorIndex(bool enabled);
+    bool hasPredecessorIndex() const;
     /**  
      *  DFS
      *
+     *  Iterative, the depth of the automaton does not use the call stack.
      *  return false if final state encountered
      */
     bool DFS(std::set<int>& visited, int s, bool return_on_final) const;
@@ -56,6 +167,13 @@ namespace fa {
     /*            MAIN             */
     /***************************** */
 
+    /**
+     * Renumber the states densely from 0 to countStates() - 1
+     *
+     * The relative order of the states is kept.
+     */
+    void compact();
+
     /**
      * Tell if an automaton is valid.
      *
@@ -185,7 +303,8 @@ namespace fa {
     bool isComplete() const;
 
     /**
-     * Make a transition from a set of states with a character.
+     * Make a transition from a set of states with a character, followed by
+     * the epsilon transitions
      */
     std::set<int> makeTransition(const std::set<int>& origin, char alpha) const;
 
@@ -199,6 +318,31 @@ namespace fa {
      */
     bool match(const std::string& word) const;
 
+    /**
+     * Tell for every word of a batch if it is in the language, with several
+     * threads (0 for one per core)
+     *
+     * The automaton is compiled once for the batch (CompiledDfa when it is
+     * deterministic, NfaSimulator otherwise) and shared by the threads, each
+     * one matching a contiguous slice with its own scratch sets. The result
+     * does not depend on the number of threads.
+     */
+    std::vector<bool> matchAll(const std::vector<std::string_view>& words, unsigned threads = 0) const;
+
+    /**
+     * Freeze a deterministic automaton into a dense transition table
+     *
+     * The automaton must be deterministic. Later changes to the automaton are
+     * not reflected in the compiled table.
+     */
+    CompiledDfa freeze() const;
+
+    /**
+     * States reachable from the given states (themselves included), in
+     * breadth-first discovery order
+     */
+    std::vector<int> reachableStates(const std::set<int>& from) const;
+
     /**
      * Remove non-accessible states
      */
@@ -209,6 +353,26 @@ namespace fa {
      */
     void removeNonCoAccessibleStates();
 
+    /**
+     * Remove states that are not both accessible and co-accessible
+     */
+    void trim();
+
+    /**
+     * Mirror the automaton in place
+     */
+    void makeMirror();
+
+    /**
+     * Complete the automaton in place, if not already complete
+     */
+    void makeComplete();
+
+    /**
+     * Turn the automaton into its complement in place
+     */
+    void makeComplement();
+
     /**
      * Check if the language of the automaton is empty
      */
@@ -216,29 +380,65 @@ namespace fa {
 
     /**
      * Tell if the intersection with another automaton is empty
+     *
+     * The product is explored on the fly, breadth-first, and the search stops
+     * at the first pair of final states. When the intersection is not empty,
+     * witness is set to a shortest word accepted by both automata.
      */
     bool hasEmptyIntersectionWith(const Automaton& other) const;
+    bool hasEmptyIntersectionWith(const Automaton& other, std::string& witness) const;
 
     /**
      * Tell if the langage accepted by the automaton is included in the
      * language accepted by the other automaton
+     *
+     * Couples (state, set of states of other) reached by the same word are
+     * explored breadth-first, and a couple is skipped when the same state was
+     * met with a smaller set by a word at most as long (antichain). When the
+     * inclusion does not hold, counterexample is
+     * set to a shortest word accepted by the automaton and not by other.
      */
     bool isIncludedIn(const Automaton& other) const;
+    bool isIncludedIn(const Automaton& other, std::string& counterexample) const;
+
+    /**
+     * Tell if both automata accept the same language
+     *
+     * The subset constructions of both automata are explored together,
+     * breadth-first, and the couples of sets already known to be equivalent
+     * are merged in a union-find (Hopcroft-Karp), so that a couple following
+     * from the merged ones is skipped. When the languages differ,
+     * counterexample is set to a word accepted by only one of them.
+     */
+    bool isEquivalentTo(const Automaton& other) const;
+    bool isEquivalentTo(const Automaton& other, std::string& counterexample) const;
 
     /**
      * Create a mirror automaton
+     *
+     * Like the other create functions taking an rvalue, the second overload
+     * transforms its argument in place instead of copying it
      */
     static Automaton createMirror(const Automaton& automaton);
+    static Automaton createMirror(Automaton&& automaton);
 
     /**
      * Create a complete automaton, if not already complete
      */
     static Automaton createComplete(const Automaton& automaton);
+    static Automaton createComplete(Automaton&& automaton);
 
     /**
      * Create a complement automaton
      */
     static Automaton createComplement(const Automaton& automaton);
+    static Automaton createComplement(Automaton&& automaton);
+
+    /**
+     * Create an equivalent automaton without epsilon transitions, with the
+     * same states
+     */
+    static Automaton createWithoutEpsilon(const Automaton& other);
 
     /**
      * Create the intersection of the languages of two automata
@@ -249,11 +449,38 @@ namespace fa {
      * Create a deterministic automaton, if not already deterministic
      */
     static Automaton createDeterministic(const Automaton& other);
+    static Automaton createDeterministic(Automaton&& other);
+
+    /**
+     * Create a deterministic automaton with several threads (0 for one per
+     * core), numbered exactly like the sequential version
+     */
+    static Automaton createDeterministic(const Automaton& other, unsigned threads);
 
     /**
      * Create an equivalent minimal automaton with the Moore algorithm
      */
     static Automaton createMinimalMoore(const Automaton& other);
+    static Automaton createMinimalMoore(Automaton&& other);
+
+    /**
+     * Create an equivalent minimal automaton with the Hopcroft algorithm
+     *
+     * Same result as createMinimalMoore, in O(|alphabet| n log n)
+     */
+    static Automaton createMinimalHopcroft(const Automaton& other);
+    static Automaton createMinimalHopcroft(Automaton&& other);
+
+    /**
+     * Create an equivalent minimal automaton with the Valmari-Lehtinen
+     * algorithm
+     *
+     * The automaton is not completed first: the result is the minimal trim
+     * deterministic automaton, without sink state unless add_sink is set, in
+     * which case the sink is only added if a transition is missing
+     */
+    static Automaton createMinimalValmari(const Automaton& other, bool add_sink = false);
+    static Automaton createMinimalValmari(Automaton&& other, bool add_sink = false);
 
     /**
      * Create an equivalent minimal automaton with the Brzozowski algorithm
@@ -262,27 +489,907 @@ namespace fa {
 
 
   private:
-    /** Alphabet
-    * Defined by a vector (https://en.cppreference.com/w/cpp/container/vector)
-    */
-    std::set<char> al;
+    /**
+     * Remove every state that is not in kept, with its transitions, in a
+     * single pass over each container
+     */
+    void keepStates(const std::set<int>& kept);
 
-    /** States
-    * states is the set of states
-    * initial_states is the set of initial states
-    * final_states is the set of final states
-    */
-    std::set<int> states;
-    std::set<int> initial_states;
-    std::set<int> final_states;
-
-    /** Transitions
-    * Defined by a map (https://en.cppreference.com/w/cpp/container/map), 
-    * the key is a couple of int - char and the value is a vector of int 
-    * the int is the state and the char the symbol
+    /**
+     * Dense set of the states reached reading the word
+     *
+     * Steps through the transitions map, so a single read only pays for the
+     * states it visits and no table is built.
+     */
+    StateSet readStates(const StateIndex& index, const std::string& word) const;
+
+    /**
+     * Rebuild the predecessor index from the transitions
+     */
+    void buildPredecessorIndex();
+
+    /**
+     * Remove state from the targets of key, and key if it has no more targets.
+     * Returns true if the state was effectively removed.
+     */
+    static bool unlink(std::map<std::pair<int, char>, std::set<int>>& transitions,
+                       std::pair<int, char> key, int state);
+
+    friend class TransitionTable;
+    friend class SymbolClasses;
+    friend class AutomatonBuilder;
+
+    /** Representation
+    * Shared between the copies of an automaton (copy-on-write): copying is
+    * O(1), and the first change made through a copy duplicates it.
     */
-    std::map<std::pair<int, char>, std::set<int>> tr;
+    struct Data {
+      /** Alphabet
+      * Defined by a 256-bit bitmap of symbols (see SymbolSet)
+      */
+      SymbolSet al;
+
+      /** States
+      * states is the set of states
+      * initial_states is the set of initial states
+      * final_states is the set of final states
+      */
+      std::set<int> states;
+      std::set<int> initial_states;
+      std::set<int> final_states;
+
+      /** Transitions
+      * Defined by a map (https://en.cppreference.com/w/cpp/container/map), 
+      * the key is a couple of int - char and the value is a vector of int 
+      * the int is the state and the char the symbol
+      */
+      std::map<std::pair<int, char>, std::set<int>> tr;
+
+      /** Predecessor index
+      * Same layout as tr with the couple (to, symbol) as key and the origins as
+      * value. Only maintained when predecessor_index is set.
+      */
+      bool predecessor_index = false;
+      std::map<std::pair<int, char>, std::set<int>> rtr;
+    };
+
+    std::shared_ptr<Data> d;
+
+    /**
+     * Representation to modify, duplicated first if it is shared
+     */
+    Data& mut();
+
+    /**
+     * Representation of an empty automaton, shared by the moved-from ones
+     */
+    static const std::shared_ptr<Data>& emptyData();
+
+  };
+
+  /**
+   * Bulk construction of an automaton from edge lists.
+   *
+   * Edges are only appended until build(), which sorts and deduplicates them
+   * once and fills the transitions in order, instead of validating each one
+   * against the automaton like Automaton::addTransition. The states met in
+   * the edges are added, as well as their symbols.
+   */
+  class AutomatonBuilder {
+  public:
+    /**
+     * Transition from -> to labelled by symbol
+     */
+    struct Edge {
+      int from;
+      char symbol;
+      int to;
+    };
+
+    /**
+     * Reserve room for a number of edges
+     */
+    void reserve(std::size_t edges);
+
+    /**
+     * Add a symbol, return false if it is not a printable symbol
+     */
+    bool addSymbol(char symbol);
+
+    /**
+     * Add a state, return false if it is negative
+     */
+    bool addState(int state);
+
+    /**
+     * Add a state and make it initial or final, return false if it is negative
+     */
+    bool setStateInitial(int state);
+    bool setStateFinal(int state);
+
+    /**
+     * Add a transition, return false if a state is negative or the symbol is
+     * neither printable nor Epsilon
+     */
+    bool addTransition(int from, char symbol, int to);
+
+    /**
+     * Add every edge of the list, return false if one of them was rejected
+     */
+    bool addTransitions(const std::vector<Edge>& edges);
+
+    /**
+     * Number of edges added so far, duplicates included
+     */
+    std::size_t countEdges() const {
+      return edges.size();
+    }
+
+    /**
+     * Create the automaton and leave the builder empty
+     */
+    Automaton build();
+
+  private:
+    static bool isValidSymbol(char symbol);
+
+    /**
+     * Sort and deduplicate the list into a set
+     */
+    static std::set<int> toSet(std::vector<int>& list);
+
+    SymbolSet al;
+    std::vector<int> states;
+    std::vector<int> initial_states;
+    std::vector<int> final_states;
+    std::vector<Edge> edges;
+  };
+
+  /**
+   * Interning of state identifiers into dense indices 0..n-1.
+   *
+   * Indices follow the increasing order of the identifiers. When identifiers
+   * are dense enough a direct lookup table is used, otherwise a binary search.
+   */
+  class StateIndex {
+  public:
+    StateIndex() = default;
+    explicit StateIndex(const std::set<int>& states);
+
+    /**
+     * Number of interned states
+     */
+    std::size_t size() const { return ids.size(); }
+
+    /**
+     * Dense index of a state, -1 if the state is unknown
+     */
+    int indexOf(int state) const;
+
+    /**
+     * State identifier of a dense index
+     */
+    int stateAt(std::size_t index) const { return ids[index]; }
+
+    /**
+     * Every state, by dense index
+     */
+    const std::vector<int>& states() const { return ids; }
+
+  private:
+    std::vector<int> ids;       // dense index -> state
+    std::vector<int> direct;    // state -> dense index, empty if too sparse
+  };
+
+  /**
+   * Compressed sparse row (CSR) view of the transitions of an automaton.
+   *
+   * States are renumbered with dense indices 0..n-1 (in increasing order of
+   * their identifier) and columns are the symbols of the alphabet, Epsilon
+   * being always column 0. Every row only holds its non-empty cells, sorted
+   * by column, and the targets of a cell are stored contiguously, as dense
+   * indices sorted in increasing order.
+   *
+   * Memory is O(states + transitions) with 32-bit offsets, whatever the size
+   * of the alphabet. Looking up a cell is a binary search in its row.
+   *
+   * The table is a snapshot: it is not updated when the automaton changes.
+   */
+  class TransitionTable {
+  public:
+    /**
+     * Contiguous range of dense target indices
+     */
+    struct Range {
+      const int* first;
+      const int* last;
+
+      const int* begin() const { return first; }
+      const int* end() const { return last; }
+      std::size_t size() const { return static_cast<std::size_t>(last - first); }
+      bool empty() const { return first == last; }
+    };
+
+    /**
+     * Build the table from the current transitions of the automaton
+     */
+    explicit TransitionTable(const Automaton& automaton);
+
+    /**
+     * Number of states (rows) and of columns (symbols + Epsilon)
+     */
+    std::size_t countStates() const;
+    std::size_t countColumns() const;
+
+    /**
+     * Dense index of a state, -1 if the state is unknown
+     */
+    int indexOf(int state) const;
+
+    /**
+     * State identifier of a dense index
+     */
+    int stateAt(std::size_t index) const;
+
+    /**
+     * Column of a symbol, -1 if the symbol is not in the alphabet
+     */
+    int columnOf(char symbol) const;
+
+    /**
+     * Symbol of a column
+     */
+    char symbolAt(std::size_t column) const;
+
+    /**
+     * Dense targets of a dense state index reading a symbol or a column
+     */
+    Range successors(std::size_t index, char symbol) const;
+    Range successorsAt(std::size_t index, std::size_t column) const;
+
+    /**
+     * The non-empty cells of a row are numbered contiguously in increasing
+     * column order, from firstCell(index) to firstCell(index + 1) - 1
+     */
+    std::size_t firstCell(std::size_t index) const { return rows[index]; }
+    std::size_t cellColumn(std::size_t cell) const { return cells[cell]; }
+    Range cellTargets(std::size_t cell) const {
+      return Range{targets.data() + offsets[cell], targets.data() + offsets[cell + 1]};
+    }
+
+    /**
+     * Targets of every cell of a row, Epsilon included, column after column
+     */
+    Range rowTargets(std::size_t index) const {
+      return Range{targets.data() + offsets[rows[index]], targets.data() + offsets[rows[index + 1]]};
+    }
+
+    /**
+     * Dense indices of the initial states, in increasing order
+     */
+    const std::vector<int>& initialStates() const;
+
+    /**
+     * Tell if the state at a dense index is final
+     */
+    bool isFinal(std::size_t index) const;
+
+  private:
+    StateIndex interned;
+    std::array<int, 256> columns;         // (unsigned char) symbol -> column
+    std::vector<char> symbols;            // column -> symbol
+    std::vector<std::uint32_t> rows;      // row -> first cell
+    std::vector<std::uint16_t> cells;     // cell -> column
+    std::vector<std::uint32_t> offsets;   // cell -> first target
+    std::vector<int> targets;
+    std::vector<int> initials;
+    std::vector<char> finals;
+  };
+
+  /**
+   * Equivalence classes of the symbols of an automaton.
+   *
+   * Two symbols are equivalent when they label exactly the same transitions
+   * in every state. Class 0 gathers every byte outside the alphabet (and
+   * Epsilon), classes 1..countClasses()-1 partition the alphabet and are
+   * numbered in the order of their first symbol.
+   */
+  class SymbolClasses {
+  public:
+    /**
+     * Single class 0: every byte is outside the alphabet
+     */
+    SymbolClasses();
+
+    /**
+     * Compute the classes of the current transitions of the automaton
+     */
+    explicit SymbolClasses(const Automaton& automaton);
+
+    /**
+     * Number of classes, class 0 included
+     */
+    std::size_t countClasses() const { return representatives.size(); }
+
+    /**
+     * Class of a symbol, 0 if the symbol is not in the alphabet
+     */
+    std::size_t classOf(char symbol) const { return classes[static_cast<unsigned char>(symbol)]; }
+
+    /**
+     * First symbol of a class (Epsilon for class 0)
+     */
+    char representative(std::size_t cls) const { return representatives[cls]; }
+
+    /**
+     * Byte -> class lookup table
+     */
+    const std::array<std::uint8_t, 256>& table() const { return classes; }
+
+  private:
+    std::array<std::uint8_t, 256> classes;
+    std::vector<char> representatives;
+  };
+
+  /**
+   * Deterministic automaton laid out as a dense table of states x classes.
+   *
+   * Columns are the symbol classes of the automaton (see SymbolClasses), a
+   * 256-byte table maps every input byte to its column. States are dense
+   * indices, a missing transition leads to the Dead sentinel which rejects the
+   * remainder of the word. Matching costs two table lookups per byte.
+   */
+  class CompiledDfa {
+  public:
+    /**
+     * Target of missing transitions
+     */
+    static constexpr int Dead = -1;
+
+    /**
+     * Compile a deterministic automaton
+     */
+    explicit CompiledDfa(const Automaton& automaton);
+
+    /**
+     * Number of states of the table
+     */
+    std::size_t countStates() const;
+
+    /**
+     * Initial state, Dead if the automaton has no initial state
+     */
+    int initialState() const;
+
+    /**
+     * Target of a transition, Dead if there is none
+     */
+    int next(int state, char symbol) const {
+      return table[static_cast<std::size_t>(state) * width + classes.classOf(symbol)];
+    }
+
+    /**
+     * Tell if a state is final
+     */
+    bool isFinal(int state) const;
+
+    /**
+     * Tell if the word is in the language accepted by the automaton
+     */
+    bool match(const std::string& word) const;
+    bool match(const char* data, std::size_t length) const;
+
+    /**
+     * Number of columns of the table
+     */
+    std::size_t countClasses() const;
+
+  private:
+    SymbolClasses classes;
+    std::size_t width;
+    int initial;
+    std::vector<int> table;   // state * width + class -> state
+    std::vector<char> finals;
+  };
+
+  /**
+   * Set of dense state indices packed in 64-bit words.
+   */
+  class StateSet {
+  public:
+    StateSet() = default;
+
+    /**
+     * Build an empty set able to hold indices 0..size-1
+     */
+    explicit StateSet(std::size_t size);
+
+    /**
+     * Capacity of the set, resizing clears it
+     */
+    std::size_t size() const { return n; }
+    void resize(std::size_t size);
+
+    void insert(std::size_t index) { bits[index >> 6] |= std::uint64_t(1) << (index & 63); }
+    void erase(std::size_t index) { bits[index >> 6] &= ~(std::uint64_t(1) << (index & 63)); }
+    bool contains(std::size_t index) const { return (bits[index >> 6] >> (index & 63)) & 1; }
+
+    void clear();
+    bool empty() const;
+    std::size_t count() const;
+
+    /**
+     * Union with another set of the same capacity
+     */
+    void merge(const StateSet& other);
+
+    /**
+     * Tell if both sets share an index
+     */
+    bool intersects(const StateSet& other) const;
+
+    /**
+     * Call f(index) for every index of the set, in increasing order
+     */
+    template<typename F>
+    void forEach(F f) const {
+      for(std::size_t w = 0; w < bits.size(); ++w){
+        std::uint64_t word = bits[w];
+        while(word != 0){
+          f((w << 6) | static_cast<std::size_t>(__builtin_ctzll(word)));
+          word &= word - 1;
+        }
+      }
+    }
+
+    /**
+     * Packed words, index i is bit (i % 64) of word i / 64
+     */
+    const std::vector<std::uint64_t>& words() const { return bits; }
+    std::vector<std::uint64_t>& words() { return bits; }
+
+    bool operator==(const StateSet& other) const { return bits == other.bits; }
+    bool operator!=(const StateSet& other) const { return bits != other.bits; }
+
+  private:
+    std::size_t n = 0;
+    std::vector<std::uint64_t> bits;
+  };
+
+  /**
+   * Epsilon closures of the states of a TransitionTable.
+   *
+   * The epsilon transitions are condensed into strongly connected components
+   * (iterative Tarjan), whose states share the same closure. Closures are
+   * then computed once per component, successors first, and stored as sorted
+   * lists of dense indices.
+   */
+  class EpsilonClosures {
+  public:
+    explicit EpsilonClosures(const TransitionTable& table);
+
+    /**
+     * Tell if there is no epsilon transition, every closure is then the state
+     * alone
+     */
+    bool trivial() const { return !has_epsilon; }
+
+    /**
+     * Dense indices reachable from a dense index through epsilon transitions,
+     * the index itself included, in increasing order
+     */
+    TransitionTable::Range closure(std::size_t index) const {
+      const std::size_t cmp = static_cast<std::size_t>(component[index]);
+      return {members.data() + offsets[cmp], members.data() + offsets[cmp + 1]};
+    }
+
+    /**
+     * Sorted closure of a set of dense indices
+     */
+    std::vector<int> closure(const std::vector<int>& states) const;
+
+    /**
+     * Replace out with the closures of a range of dense indices, unsorted
+     * and possibly with duplicates
+     */
+    void closure(TransitionTable::Range states, std::vector<int>& out) const;
+
+    /**
+     * Add to the set the closure of its states
+     */
+    void close(StateSet& states) const;
+
+    /**
+     * Append to out the sorted closure of the successors of some dense
+     * indices in a column, and return its hash (see SubsetTable::hashOf).
+     *
+     * marks holds a flag per dense index, all cleared, and is left cleared.
+     */
+    std::uint64_t closedSuccessors(TransitionTable::Range from, const TransitionTable& table, std::size_t column,
+                                   std::vector<char>& marks, std::vector<int>& out) const;
+    std::uint64_t closedSuccessors(const std::vector<int>& from, const TransitionTable& table, std::size_t column,
+                                   std::vector<char>& marks, std::vector<int>& out) const {
+      return closedSuccessors(TransitionTable::Range{from.data(), from.data() + from.size()}, table, column, marks, out);
+    }
+
+  private:
+    bool has_epsilon = false;
+    std::vector<int> component;       // dense index -> component
+    std::vector<std::size_t> offsets; // component -> first member of its closure
+    std::vector<int> members;
+  };
+
+  /**
+   * Interning of subsets of dense state indices, numbered from 0 in insertion
+   * order.
+   *
+   * Subsets are sorted vectors stored back to back and found through an open
+   * addressing table. Their hash is the sum of the hashes of their indices,
+   * so it does not depend on the order and can be computed while a subset is
+   * gathered.
+   */
+  class SubsetTable {
+  public:
+    SubsetTable();
+
+    /**
+     * Contribution of one index to the hash of a subset
+     */
+    static std::uint64_t hashOf(int index) {
+      std::uint64_t x = static_cast<std::uint64_t>(index) + 0x9e3779b97f4a7c15ULL;
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      return x ^ (x >> 31);
+    }
+
+    /**
+     * Hash of a whole subset
+     */
+    static std::uint64_t hashOf(const std::vector<int>& subset);
+
+    /**
+     * Number of a sorted subset, inserted if it is new (second is then true)
+     */
+    std::pair<int, bool> insert(const int* first, const int* last, std::uint64_t hash);
+    std::pair<int, bool> insert(const std::vector<int>& subset, std::uint64_t hash) {
+      return insert(subset.data(), subset.data() + subset.size(), hash);
+    }
+
+    /**
+     * Number of a sorted subset, -1 if it is unknown
+     */
+    int find(const int* first, const int* last, std::uint64_t hash) const;
+    int find(const std::vector<int>& subset, std::uint64_t hash) const {
+      return find(subset.data(), subset.data() + subset.size(), hash);
+    }
+
+    /**
+     * Indices of a subset, invalidated by the next insertion
+     */
+    TransitionTable::Range subset(std::size_t id) const;
+
+    std::size_t size() const { return hashes.size(); }
+
+    /**
+     * Bytes held by the table
+     */
+    std::size_t memoryUsage() const;
+
+    void clear();
+
+  private:
+    bool equals(std::size_t id, const int* first, const int* last) const;
+    void grow();
+
+    std::vector<int> elems;             // subsets back to back
+    std::vector<std::size_t> offsets;   // id -> first index in elems
+    std::vector<std::uint64_t> hashes;  // id -> hash
+    std::vector<int> slots;             // open addressing, -1 if empty
+  };
+
+  /**
+   * Simulation of a (non-deterministic) automaton on bitsets of states.
+   *
+   * The active states are a StateSet over the dense indices of a
+   * TransitionTable. When the automaton is small enough, the successors of
+   * every (state, symbol class) couple are precomputed as bitmasks so a step
+   * is a word-wide OR per active state. Otherwise the targets are set one by one
+   * from the table. Stepping never allocates.
+   */
+  class NfaSimulator {
+  public:
+    /**
+     * Build the simulator, with successor masks if asked and if they fit
+     * in the mask budget
+     */
+    explicit NfaSimulator(const Automaton& automaton, bool precompute_masks = true);
+
+    /**
+     * Number of dense states, the capacity of the sets given to the simulator
+     */
+    std::size_t countStates() const;
+
+    /**
+     * The underlying transition table (dense indices <-> states)
+     */
+    const TransitionTable& table() const;
+
+    /**
+     * Tell if successor masks are used
+     */
+    bool hasMasks() const;
+
+    /**
+     * Set current to the initial states
+     */
+    void start(StateSet& current) const;
+
+    /**
+     * Compute in next the states reached from current reading the symbol
+     */
+    void step(const StateSet& current, char symbol, StateSet& next) const;
+
+    /**
+     * Tell if the set contains a final state
+     */
+    bool isAccepting(const StateSet& current) const;
+
+    /**
+     * Tell if the word is in the language accepted by the automaton
+     */
+    bool match(const std::string& word) const;
+
+    /**
+     * Same, with scratch sets of capacity countStates() given by the caller
+     */
+    bool match(const char* data, std::size_t length, StateSet& current, StateSet& next) const;
+
+    /**
+     * Maximum number of 64-bit words allocated for successor masks
+     */
+    static constexpr std::size_t MaskBudget = std::size_t(1) << 20;
+
+  private:
+    TransitionTable transitions;
+    EpsilonClosures closures;
+    SymbolClasses classes;
+    StateSet initials;
+    StateSet finals;
+    std::size_t words;
+    std::vector<std::uint64_t> masks; // ((class * n) + state) * words
+  };
+
+  /**
+   * Matching through a deterministic automaton built on demand.
+   *
+   * States are subsets of dense states of the automaton, created the first
+   * time a word reaches them, and their transitions are cached per symbol
+   * class. When the cache grows over the memory budget it is flushed and
+   * rebuilt from the current state, so the memory does not depend on the
+   * size of the full determinization.
+   *
+   * State numbers are only valid until the next call to start() or next().
+   */
+  class LazyDfa {
+  public:
+    /**
+     * Target of transitions leading to the empty set
+     */
+    static constexpr int Dead = -1;
+
+    /**
+     * Default memory budget of the cache, in bytes
+     */
+    static constexpr std::size_t DefaultBudget = std::size_t(1) << 24;
+
+    explicit LazyDfa(const Automaton& automaton, std::size_t budget = DefaultBudget);
+
+    /**
+     * Initial state, Dead if the automaton has no initial state
+     */
+    int start();
+
+    /**
+     * Target of a transition, computed and cached on first use
+     */
+    int next(int state, char symbol);
+
+    /**
+     * Tell if a state is final
+     */
+    bool isFinal(int state) const;
+
+    /**
+     * Tell if the word is in the language accepted by the automaton
+     */
+    bool match(const std::string& word);
+    bool match(const char* data, std::size_t length);
+
+    /**
+     * Number of states in the cache, and number of flushes so far
+     */
+    std::size_t countStates() const;
+    std::size_t countFlushes() const;
+
+    /**
+     * Bytes held by the cache
+     */
+    std::size_t memoryUsage() const;
+
+  private:
+    static constexpr int Unknown = -2;
+
+    /**
+     * State of the sorted subset in arrival, created if it is new
+     */
+    int intern(std::uint64_t hash);
+
+    void flush();
+
+    TransitionTable transitions;
+    EpsilonClosures closures;
+    SymbolClasses classes;
+    std::size_t width;
+    std::size_t budget;
+    std::size_t flushes = 0;
+    SubsetTable subsets;
+    std::vector<int> table;   // state * width + class -> state, Unknown or Dead
+    std::vector<char> finals;
+    std::vector<char> in_arrival;
+    std::vector<int> arrival;
+  };
+
+  /**
+   * Incremental matching of a word given in chunks.
+   *
+   * The automaton is compiled once, as a CompiledDfa when it is deterministic
+   * and as a NfaSimulator otherwise. The session keeps the current DFA state,
+   * or the current set of states, between chunks: feeding costs a step per
+   * byte and never allocates.
+   */
+  class Matcher {
+  public:
+    explicit Matcher(const Automaton& automaton);
+
+    /**
+     * Read a chunk of the word
+     */
+    void feed(const char* data, std::size_t length);
+    void feed(std::string_view chunk) { feed(chunk.data(), chunk.size()); }
+
+    /**
+     * Tell if the input fed since the last reset is in the language
+     */
+    bool isAccepting() const;
+
+    /**
+     * Tell if no state is left, so no continuation of the input is accepted
+     */
+    bool isDead() const;
+
+    /**
+     * Start a new word
+     */
+    void reset();
+
+  private:
+    std::unique_ptr<CompiledDfa> dfa;
+    std::unique_ptr<NfaSimulator> simulator;
+    int state;
+    StateSet current;
+    StateSet next;
+  };
+
+  /**
+   * Search of the substrings of a text accepted by an automaton.
+   *
+   * A backward pass with the determinized mirror, whose start state loops on
+   * every symbol, marks the positions where a match starts. From the leftmost
+   * start, the minimal trim deterministic automaton runs forward to find the
+   * end: the first final state reached for LeftmostFirst, the last one for
+   * LeftmostLongest. Having no sink state, it stops as soon as no longer
+   * match is possible instead of running to the end of the text.
+   * An automaton has no alternation order to give priority to, so
+   * LeftmostFirst is the shortest match from the leftmost start.
+   *
+   * Matches do not overlap, the search resumes at the end of the previous
+   * match, one byte further after an empty match.
+   */
+  class Searcher {
+  public:
+    enum class Kind {
+      LeftmostFirst,
+      LeftmostLongest,
+    };
+
+    /**
+     * Substring [start, end) of the text
+     */
+    struct Match {
+      std::size_t start;
+      std::size_t end;
+    };
+
+    explicit Searcher(const Automaton& automaton);
+
+    /**
+     * First match in the text, returns false if there is none
+     */
+    bool find(std::string_view text, Match& match, Kind kind = Kind::LeftmostLongest) const;
+
+    /**
+     * Every match in the text, from left to right
+     */
+    std::vector<Match> findAll(std::string_view text, Kind kind = Kind::LeftmostLongest) const;
+
+    /**
+     * Automaton run forward from a start to find the end of a match. It has
+     * no sink state: a run reaches CompiledDfa::Dead as soon as no longer
+     * match is possible.
+     */
+    const CompiledDfa& forwardDfa() const { return forward; }
+
+  private:
+    /**
+     * Mirror of the automaton with a new initial state looping on every
+     * symbol, with Epsilon transitions to the former initial states
+     */
+    static Automaton createUnanchoredMirror(const Automaton& automaton);
+
+    /**
+     * starts[i] tells if a match starts at position i (0..size of the text)
+     */
+    void findStarts(std::string_view text, std::vector<char>& starts) const;
+
+    /**
+     * End of the match starting at a position known to start one
+     */
+    std::size_t findEnd(std::string_view text, std::size_t start, Kind kind) const;
+
+    CompiledDfa forward;
+    CompiledDfa backward;
+  };
+
+  /**
+   * Breadth-first traversal engine over a TransitionTable.
+   *
+   * Works on dense indices with an explicit queue, so the depth of the
+   * automaton does not matter. The visited set is kept between runs and only
+   * the states of the previous run are cleared, so one engine can be reused
+   * for many traversals.
+   */
+  class Traversal {
+  public:
+    /**
+     * The table must outlive the traversal
+     */
+    explicit Traversal(const TransitionTable& table);
+
+    /**
+     * Visit every state reachable from the dense sources (Epsilon transitions
+     * included). Returns the visited states in discovery order.
+     */
+    const std::vector<int>& run(const std::vector<int>& sources);
+
+    /**
+     * Same as run but stop at the first final state, which is returned (-1
+     * if none is reachable)
+     */
+    int findFinal(const std::vector<int>& sources);
+
+    /**
+     * States visited by the last run
+     */
+    const StateSet& visited() const;
+    const std::vector<int>& order() const;
+
+  private:
+    void reset();
+    bool discover(int st);
 
+    const TransitionTable& table;
+    StateSet seen;
+    std::vector<int> queue;
   };
 
 }
@@ -2,6 +2,8 @@
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <random>
+#include <sstream>
 #include <vector>
 
 #include "Automaton.h"
@@ -25,6 +27,66 @@ fa::Automaton createAutomaton(int nbState, std::vector<char> symbols){
   return fa;
 }
 
+fa::Automaton createRandomAutomaton(int nbState, std::vector<char> symbols, int nbTransition, unsigned seed){
+  std::mt19937 gen(seed);
+  fa::Automaton fa = createAutomaton(nbState, symbols);
+  fa.setStateInitial(gen() % nbState);
+  for(int i = 0 ; i < nbState ; ++i){
+    if(gen() % 3 == 0) fa.setStateFinal(i);
+  }
+  for(int i = 0 ; i < nbTransition ; ++i){
+    fa.addTransition(gen() % nbState, symbols[gen() % symbols.size()], gen() % nbState);
+  }
+  return fa;
+}
+
+fa::Automaton createThirdFromEnd(){
+  // Words whose third letter from the end is an 'a'
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(4, symbols);
+  fa.setStateInitial(3);
+  fa.setStateFinal(0);
+  fa.addTransition(3, 'a', 3);
+  fa.addTransition(3, 'b', 3);
+  fa.addTransition(3, 'a', 2);
+  fa.addTransition(2, 'a', 1);
+  fa.addTransition(2, 'b', 1);
+  fa.addTransition(1, 'a', 0);
+  fa.addTransition(1, 'b', 0);
+  return fa;
+}
+
+fa::Automaton createThompson(){
+  // (ab|a)*b with the epsilon transitions of the Thompson construction
+  fa::Automaton fa = createAutomaton(10, {'a', 'b'});
+  fa.setStateInitial(0);
+  fa.setStateFinal(9);
+  fa.addTransition(0, fa::Epsilon, 1);
+  fa.addTransition(0, fa::Epsilon, 8);
+  fa.addTransition(1, fa::Epsilon, 2);
+  fa.addTransition(1, fa::Epsilon, 5);
+  fa.addTransition(2, 'a', 3);
+  fa.addTransition(3, 'b', 4);
+  fa.addTransition(5, 'a', 6);
+  fa.addTransition(4, fa::Epsilon, 7);
+  fa.addTransition(6, fa::Epsilon, 7);
+  fa.addTransition(7, fa::Epsilon, 1);
+  fa.addTransition(7, fa::Epsilon, 8);
+  fa.addTransition(8, 'b', 9);
+  return fa;
+}
+
+fa::Automaton createEpsilonChain(){
+  // Only "a", with epsilon transitions before and after the letter
+  fa::Automaton fa = createAutomaton(4, {'a', 'b'});
+  fa.setStateInitial(0);
+  fa.setStateFinal(3);
+  fa.addTransition(0, fa::Epsilon, 1);
+  fa.addTransition(1, 'a', 2);
+  fa.addTransition(2, fa::Epsilon, 3);
+  return fa;
+}
+
 /***************************** */
 /*           TESTS             */
 /***************************** */
@@ -34,6 +96,111 @@ TEST(AutomatonExampleTest, Default) {
   EXPECT_FALSE(fa.isValid());
 }
 
+/***************************** */
+/*          Accessors          */
+/***************************** */
+
+TEST(accessorsTest, NoCopy) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(2, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(1);
+  fa.addTransition(0, 'a', 1);
+
+  EXPECT_EQ(&fa.getSt(), &fa.getSt());
+  EXPECT_EQ(&fa.getTr(), &fa.getTr());
+  EXPECT_EQ(&fa.getAl(), &fa.getAl());
+  EXPECT_EQ(fa.getInitialSt(), (std::set<int>{0}));
+  EXPECT_EQ(fa.getFinalSt(), (std::set<int>{1}));
+  EXPECT_EQ(fa.getTr().size(), 1u);
+
+  std::set<char> al = fa.getAl();
+  EXPECT_EQ(al, (std::set<char>{'a', 'b'}));
+}
+
+TEST(accessorsTest, Setters) {
+  fa::Automaton fa;
+  fa.setAl(std::set<char>{'x', 'y'});
+  fa.setSt({1, 2});
+  fa.setInitSt({1});
+  fa.setFinalSt({2});
+  fa.setTr({{{1, 'x'}, {2}}});
+
+  fa::Automaton other;
+  other.copy(fa);
+
+  EXPECT_TRUE(other.isValid());
+  EXPECT_EQ(other.countSymbols(), 2u);
+  EXPECT_TRUE(other.match("x"));
+  EXPECT_FALSE(other.match("y"));
+}
+
+TEST(copyOnWriteTest, CopySharesData) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(3, symbols);
+  fa.addTransition(0, 'a', 1);
+
+  fa::Automaton copy = fa;
+  EXPECT_EQ(&copy.getTr(), &fa.getTr());
+  EXPECT_EQ(&copy.getSt(), &fa.getSt());
+
+  fa::Automaton assigned;
+  assigned.copy(fa);
+  EXPECT_EQ(&assigned.getTr(), &fa.getTr());
+}
+
+TEST(copyOnWriteTest, MutationDetaches) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(3, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(1);
+  fa.addTransition(0, 'a', 1);
+
+  fa::Automaton copy = fa;
+  EXPECT_TRUE(copy.addTransition(1, 'b', 2));
+  copy.removeState(0);
+
+  EXPECT_NE(&copy.getTr(), &fa.getTr());
+  EXPECT_EQ(fa.countStates(), 3u);
+  EXPECT_EQ(fa.countTransitions(), 1u);
+  EXPECT_TRUE(fa.match("a"));
+  EXPECT_EQ(copy.countStates(), 2u);
+  EXPECT_EQ(copy.countTransitions(), 1u);
+}
+
+TEST(copyOnWriteTest, NoOpKeepsSharing) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(2, symbols);
+  fa.setStateInitial(0);
+  fa.addTransition(0, 'a', 1);
+
+  fa::Automaton copy = fa;
+  EXPECT_FALSE(copy.addTransition(0, 'a', 1));
+  EXPECT_FALSE(copy.addState(1));
+  EXPECT_FALSE(copy.removeTransition(1, 'b', 0));
+  EXPECT_EQ(&copy.getTr(), &fa.getTr());
+
+  copy.removeNonAccessibleStates();
+  EXPECT_EQ(&copy.getSt(), &fa.getSt());
+}
+
+TEST(copyOnWriteTest, DerivedAutomatonKeepsOriginal) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(2, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(1);
+  fa.addTransition(0, 'a', 1);
+  fa.addTransition(0, 'a', 0);
+
+  fa::Automaton complement = fa::Automaton::createComplement(fa);
+  EXPECT_TRUE(complement.isValid());
+  EXPECT_EQ(fa.countStates(), 2u);
+  EXPECT_EQ(fa.countTransitions(), 2u);
+  EXPECT_FALSE(fa.isDeterministic());
+  EXPECT_FALSE(complement.match("a"));
+  EXPECT_TRUE(complement.match("b"));
+}
+
 /***************************** */
 /*          isValid            */
 /***************************** */
@@ -155,6 +322,41 @@ TEST(countSymbolsTest, TwoSymbols) {
   EXPECT_TRUE(fa.countSymbols() == 2); 
 }
 
+/***************************** */
+/*          SymbolSet          */
+/***************************** */
+
+TEST(symbolSetTest, SameOrderAsSet) {
+  std::set<char> expected = {'z', 'a', '0', '~', '!', 'M'};
+  fa::SymbolSet symbols(expected);
+  EXPECT_EQ(symbols.size(), expected.size());
+  EXPECT_EQ(std::vector<char>(symbols.begin(), symbols.end()),
+            std::vector<char>(expected.begin(), expected.end()));
+  EXPECT_EQ(symbols.toSet(), expected);
+}
+
+TEST(symbolSetTest, InsertEraseRank) {
+  fa::SymbolSet symbols;
+  EXPECT_TRUE(symbols.empty());
+  EXPECT_TRUE(symbols.insert('b'));
+  EXPECT_FALSE(symbols.insert('b'));
+  EXPECT_TRUE(symbols.insert('a'));
+  EXPECT_TRUE(symbols.insert('x'));
+  EXPECT_EQ(symbols.rank('a'), 0u);
+  EXPECT_EQ(symbols.rank('b'), 1u);
+  EXPECT_EQ(symbols.rank('x'), 2u);
+  EXPECT_TRUE(symbols.erase('b'));
+  EXPECT_FALSE(symbols.erase('b'));
+  EXPECT_FALSE(symbols.contains('b'));
+  EXPECT_EQ(symbols.rank('x'), 1u);
+}
+
+TEST(symbolSetTest, Intersection) {
+  fa::SymbolSet lhs(std::set<char>{'a', 'b', 'c'});
+  fa::SymbolSet rhs(std::set<char>{'b', 'c', 'd'});
+  EXPECT_EQ((lhs & rhs).toSet(), (std::set<char>{'b', 'c'}));
+}
+
 /***************************** */
 /*          AddState           */
 /***************************** */ 
@@ -238,6 +440,42 @@ TEST(removeStateTest, SourceAndDestinationInTransition) {
   EXPECT_EQ(fa.countTransitions(), 0u);
 }
 
+/***************************** */
+/*           Compact           */
+/***************************** */
+
+TEST(compactTest, Renumber) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(0, symbols);
+  EXPECT_TRUE(fa.addState(4));
+  EXPECT_TRUE(fa.addState(9));
+  EXPECT_TRUE(fa.addState(1000));
+  fa.setStateInitial(9);
+  fa.setStateFinal(1000);
+  EXPECT_TRUE(fa.addTransition(9, 'a', 1000));
+  EXPECT_TRUE(fa.addTransition(1000, 'a', 4));
+
+  fa.compact();
+
+  EXPECT_EQ(fa.getSt(), (std::set<int>{0, 1, 2}));
+  EXPECT_TRUE(fa.isStateInitial(1));
+  EXPECT_TRUE(fa.isStateFinal(2));
+  EXPECT_TRUE(fa.hasTransition(1, 'a', 2));
+  EXPECT_TRUE(fa.hasTransition(2, 'a', 0));
+  EXPECT_EQ(fa.countTransitions(), 2u);
+  EXPECT_TRUE(fa.match("a"));
+}
+
+TEST(compactTest, AlreadyDense) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(3, symbols);
+  fa.setStateInitial(0);
+  EXPECT_TRUE(fa.addTransition(0, 'a', 2));
+  fa.compact();
+  EXPECT_EQ(fa.countStates(), 3u);
+  EXPECT_TRUE(fa.hasTransition(0, 'a', 2));
+}
+
 /***************************** */
 /*          HasState           */
 /***************************** */ 
@@ -470,6 +708,19 @@ TEST(removeTransitionTest, NoSymbolInTransition) {
   EXPECT_FALSE(fa.removeTransition(0, 'a', 1));
 }
 
+TEST(removeTransitionTest, KeepOtherTargets) {
+  fa::Automaton fa = fa::Automaton();
+  fa.addSymbol('a');
+  fa.addState(0);
+  fa.addState(1);
+  fa.addState(2);
+  fa.addTransition(0, 'a', 1);
+  fa.addTransition(0, 'a', 2);
+  EXPECT_TRUE(fa.removeTransition(0, 'a', 1));
+  EXPECT_TRUE(fa.hasTransition(0, 'a', 2));
+  EXPECT_EQ(fa.countTransitions(), 1u);
+}
+
 /***************************** */
 /*        HasTransition        */
 /***************************** */ 
@@ -504,7 +755,15 @@ TEST(prettyPrintTest, AnyValidAutomaton) {
   fa.addTransition(0, 'a', 1);
   fa.addTransition(0, 'a', 2);
   fa.addTransition(1, 'a', 0);
-  fa.prettyPrint(std::cout);
+  std::ostringstream os;
+  fa.prettyPrint(os);
+  EXPECT_EQ(os.str(),
+    "\nInitial states :\n\t0 "
+    "\nFinal states :\n\t1 2 "
+    "\nTransitions :"
+    "\n\tFor state 0 :\n\t\tFor letter a : 1 2 "
+    "\n\tFor state 1 :\n\t\tFor letter a : 0 "
+    "\n\n");
 }
 
 /***************************** */
@@ -872,6 +1131,183 @@ TEST(removeNonAccessibleStates, Many) {
   EXPECT_EQ(2u,fa.countTransitions());
 }
 
+TEST(removeNonAccessibleStates, LongChain) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(5000, symbols);
+  fa.setStateInitial(0);
+  for(int i = 0; i < 2499; ++i){
+    EXPECT_TRUE(fa.addTransition(i, 'a', i + 1));
+  }
+  for(int i = 2500; i < 4999; ++i){
+    EXPECT_TRUE(fa.addTransition(i, 'b', i + 1));
+  }
+
+  fa.removeNonAccessibleStates();
+
+  EXPECT_EQ(fa.countStates(), 2500u);
+  EXPECT_EQ(fa.countTransitions(), 2499u);
+  EXPECT_FALSE(fa.hasState(2500));
+}
+
+/***************************** */
+/*       IsLanguageEmpty       */
+/***************************** */
+
+TEST(isLanguageEmptyTest, FinalBehindFirstSuccessor) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(4, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(3);
+  EXPECT_TRUE(fa.addTransition(0, 'a', 1));
+  EXPECT_TRUE(fa.addTransition(0, 'b', 2));
+  EXPECT_TRUE(fa.addTransition(1, 'a', 3));
+  EXPECT_FALSE(fa.isLanguageEmpty());
+}
+
+TEST(isLanguageEmptyTest, UnreachableFinal) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(3, symbols);
+  fa.setStateInitial(0);
+  fa.setStateInitial(1);
+  fa.setStateFinal(2);
+  EXPECT_TRUE(fa.addTransition(0, 'a', 1));
+  EXPECT_TRUE(fa.addTransition(1, 'a', 0));
+  EXPECT_TRUE(fa.addTransition(2, 'a', 0));
+  EXPECT_TRUE(fa.isLanguageEmpty());
+}
+
+/***************************** */
+/* RemoveNonCoAccessibleStates */
+/***************************** */
+
+fa::Automaton createCoAccessibleExample(bool indexed){
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(5, symbols);
+  fa.setPredecessorIndex(indexed);
+  fa.setStateInitial(0);
+  fa.setStateFinal(2);
+  EXPECT_TRUE(fa.addTransition(0, 'a', 1));
+  EXPECT_TRUE(fa.addTransition(1, fa::Epsilon, 2));
+  EXPECT_TRUE(fa.addTransition(0, 'b', 3));
+  EXPECT_TRUE(fa.addTransition(3, 'a', 3));
+  EXPECT_TRUE(fa.addTransition(4, 'a', 0));
+  return fa;
+}
+
+TEST(removeNonCoAccessibleStatesTest, WithoutIndex) {
+  fa::Automaton fa = createCoAccessibleExample(false);
+  EXPECT_FALSE(fa.hasPredecessorIndex());
+
+  fa.removeNonCoAccessibleStates();
+
+  EXPECT_EQ(fa.getSt(), (std::set<int>{0, 1, 2, 4}));
+  EXPECT_EQ(fa.countTransitions(), 3u);
+  EXPECT_TRUE(fa.isStateInitial(0));
+}
+
+TEST(removeNonCoAccessibleStatesTest, WithIndex) {
+  fa::Automaton fa = createCoAccessibleExample(true);
+  EXPECT_TRUE(fa.hasPredecessorIndex());
+
+  fa.removeNonCoAccessibleStates();
+
+  EXPECT_EQ(fa.getSt(), (std::set<int>{0, 1, 2, 4}));
+  EXPECT_EQ(fa.countTransitions(), 3u);
+
+  // The index follows the changes
+  EXPECT_TRUE(fa.removeTransition(1, fa::Epsilon, 2));
+  fa.removeNonCoAccessibleStates();
+  EXPECT_EQ(fa.getSt(), (std::set<int>{2}));
+}
+
+TEST(removeNonCoAccessibleStatesTest, NoFinalState) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(3, symbols);
+  fa.setStateInitial(0);
+  EXPECT_TRUE(fa.addTransition(0, 'a', 1));
+  fa.removeNonCoAccessibleStates();
+  EXPECT_TRUE(fa.isValid());
+  EXPECT_EQ(fa.countStates(), 1u);
+  EXPECT_TRUE(fa.isLanguageEmpty());
+}
+
+TEST(removeStateTest, WithPredecessorIndex) {
+  fa::Automaton fa = createCoAccessibleExample(true);
+  EXPECT_TRUE(fa.removeState(1));
+  EXPECT_EQ(fa.countTransitions(), 3u);
+  EXPECT_TRUE(fa.removeState(3));
+  EXPECT_EQ(fa.countTransitions(), 1u);
+  EXPECT_TRUE(fa.hasTransition(4, 'a', 0));
+  fa.removeNonCoAccessibleStates();
+  EXPECT_EQ(fa.getSt(), (std::set<int>{2}));
+}
+
+TEST(removeStateTest, EpsilonTransition) {
+  fa::Automaton fa = createCoAccessibleExample(false);
+  EXPECT_TRUE(fa.removeState(2));
+  EXPECT_FALSE(fa.hasTransition(1, fa::Epsilon, 2));
+  EXPECT_FALSE(fa.hasEpsilonTransition());
+}
+
+/***************************** */
+/*      ReachableStates        */
+/***************************** */
+
+TEST(reachableStatesTest, DiscoveryOrder) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(6, symbols);
+  EXPECT_TRUE(fa.addTransition(0, 'b', 3));
+  EXPECT_TRUE(fa.addTransition(0, 'a', 1));
+  EXPECT_TRUE(fa.addTransition(1, 'a', 4));
+  EXPECT_TRUE(fa.addTransition(3, fa::Epsilon, 2));
+  EXPECT_TRUE(fa.addTransition(5, 'a', 0));
+
+  EXPECT_EQ(fa.reachableStates({0}), (std::vector<int>{0, 1, 3, 4, 2}));
+  EXPECT_EQ(fa.reachableStates({4}), (std::vector<int>{4}));
+  EXPECT_EQ(fa.reachableStates({5, 42}).size(), 6u);
+}
+
+TEST(reachableStatesTest, ReuseTraversal) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(3, symbols);
+  fa.setStateFinal(2);
+  EXPECT_TRUE(fa.addTransition(0, 'a', 1));
+  EXPECT_TRUE(fa.addTransition(1, 'a', 2));
+
+  fa::TransitionTable table(fa);
+  fa::Traversal traversal(table);
+
+  EXPECT_EQ(traversal.run({1}).size(), 2u);
+  EXPECT_FALSE(traversal.visited().contains(0));
+  EXPECT_EQ(traversal.run({0}).size(), 3u);
+  EXPECT_EQ(traversal.findFinal({0}), 2);
+  EXPECT_EQ(traversal.findFinal({2}), 2);
+  EXPECT_EQ(traversal.order().size(), 1u);
+}
+
+TEST(reachableStatesTest, DeepChain) {
+  static const int size = 200000;
+  fa::Automaton fa;
+  EXPECT_TRUE(fa.addSymbol('a'));
+  for(int i = 0; i < size; ++i){
+    fa.addState(i);
+  }
+  for(int i = 0; i + 1 < size; ++i){
+    fa.addTransition(i, 'a', i + 1);
+  }
+  fa.setStateInitial(0);
+  fa.setStateFinal(size - 1);
+
+  EXPECT_FALSE(fa.isLanguageEmpty());
+  std::set<int> visited;
+  EXPECT_FALSE(fa.DFS(visited, 0, true));
+  visited.clear();
+  EXPECT_TRUE(fa.DFS(visited, 0, false));
+  EXPECT_EQ(visited.size(), static_cast<std::size_t>(size));
+  fa.removeNonAccessibleStates();
+  EXPECT_EQ(fa.countStates(), static_cast<std::size_t>(size));
+}
+
 /***************************** */
 /*     CreateDeterministic     */
 /***************************** */ 
@@ -962,6 +1398,81 @@ TEST(createDeterministicTest, Many) {
   EXPECT_TRUE(fa.isDeterministic());
 }
 
+TEST(createDeterministicTest, SameLanguage) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  // Words whose third letter from the end is an 'a'
+  fa::Automaton fa = createAutomaton(4, symbols);
+  fa.setStateInitial(3);
+  fa.setStateFinal(0);
+  EXPECT_TRUE(fa.addTransition(3, 'a', 3));
+  EXPECT_TRUE(fa.addTransition(3, 'b', 3));
+  EXPECT_TRUE(fa.addTransition(3, 'a', 2));
+  EXPECT_TRUE(fa.addTransition(2, 'a', 1));
+  EXPECT_TRUE(fa.addTransition(2, 'b', 1));
+  EXPECT_TRUE(fa.addTransition(1, 'a', 0));
+  EXPECT_TRUE(fa.addTransition(1, 'b', 0));
+
+  fa::Automaton dfa = fa::Automaton::createDeterministic(fa);
+
+  EXPECT_TRUE(dfa.isDeterministic());
+  EXPECT_EQ(dfa.countStates(), 8u);
+  for(auto word : {"abb", "aab", "babb", "bbbaaa", "", "a", "bab", "abbb"}){
+    EXPECT_EQ(fa.match(word), dfa.match(word));
+  }
+}
+
+TEST(createDeterministicTest, Blowup) {
+  // Words whose 15th letter from the end is an 'a', 2^15 subsets
+  const int n = 15;
+  fa::AutomatonBuilder builder;
+  builder.setStateInitial(0);
+  builder.setStateFinal(n);
+  builder.addTransitions({{0, 'a', 0}, {0, 'b', 0}, {0, 'a', 1}});
+  for(int st = 1; st < n; ++st){
+    builder.addTransitions({{st, 'a', st + 1}, {st, 'b', st + 1}});
+  }
+  fa::Automaton fa = builder.build();
+
+  fa::Automaton dfa = fa::Automaton::createDeterministic(fa);
+  EXPECT_TRUE(dfa.isDeterministic());
+  EXPECT_TRUE(dfa.isComplete());
+  EXPECT_EQ(dfa.countStates(), std::size_t(1) << n);
+  EXPECT_TRUE(dfa.match("abbbbbbbbbbbbbb"));
+  EXPECT_FALSE(dfa.match("abbbbbbbbbbbbbbb"));
+}
+
+TEST(createDeterministicTest, ThreadsSameNumbering) {
+  static const std::vector<char> symbols = {'a', 'b', 'c'};
+  for(unsigned seed = 0; seed < 50; ++seed){
+    fa::Automaton fa = createRandomAutomaton(6 + seed % 10, symbols, 30, seed);
+    fa::Automaton sequential = fa::Automaton::createDeterministic(fa);
+    for(unsigned threads : {0u, 2u, 4u}){
+      fa::Automaton parallel = fa::Automaton::createDeterministic(fa, threads);
+      EXPECT_EQ(parallel.getSt(), sequential.getSt());
+      EXPECT_EQ(parallel.getInitialSt(), sequential.getInitialSt());
+      EXPECT_EQ(parallel.getFinalSt(), sequential.getFinalSt());
+      EXPECT_EQ(parallel.getTr(), sequential.getTr());
+    }
+  }
+}
+
+TEST(createDeterministicTest, ThreadsBlowup) {
+  // Words whose 13th letter from the end is an 'a', several chunks per level
+  const int n = 13;
+  fa::AutomatonBuilder builder;
+  builder.setStateInitial(0);
+  builder.setStateFinal(n);
+  builder.addTransitions({{0, 'a', 0}, {0, 'b', 0}, {0, 'a', 1}});
+  for(int st = 1; st < n; ++st){
+    builder.addTransitions({{st, 'a', st + 1}, {st, 'b', st + 1}});
+  }
+  fa::Automaton fa = builder.build();
+
+  fa::Automaton parallel = fa::Automaton::createDeterministic(fa, 8);
+  EXPECT_EQ(parallel.countStates(), std::size_t(1) << n);
+  EXPECT_EQ(parallel.getTr(), fa::Automaton::createDeterministic(fa).getTr());
+}
+
 /***************************** */
 /*         MinimalMoore        */
 /***************************** */ 
@@ -1140,44 +1651,252 @@ TEST(minimalMooreTest, Many) {
 	EXPECT_TRUE(minimal_fa.isIncludedIn(fa));
 }
 
+TEST(minimalMooreTest, SparseStates) {
+  static const std::vector<char> symbols = {'a','b'};
+  fa::Automaton fa = createAutomaton(0, symbols);
+  for(int st : {10, 20, 30, 40}){
+    EXPECT_TRUE(fa.addState(st));
+  }
+  fa.setStateInitial(10);
+  fa.setStateFinal(30);
+  fa.setStateFinal(40);
+  EXPECT_TRUE(fa.addTransition(10, 'a', 20));
+  EXPECT_TRUE(fa.addTransition(10, 'b', 20));
+  EXPECT_TRUE(fa.addTransition(20, 'a', 30));
+  EXPECT_TRUE(fa.addTransition(20, 'b', 40));
+  EXPECT_TRUE(fa.addTransition(30, 'a', 30));
+  EXPECT_TRUE(fa.addTransition(40, 'a', 40));
+
+  fa::Automaton minimal_fa = fa.createMinimalMoore(fa);
+
+  EXPECT_TRUE(minimal_fa.isDeterministic());
+  EXPECT_TRUE(minimal_fa.isComplete());
+  EXPECT_EQ(minimal_fa.countStates(), 4u);
+  EXPECT_TRUE(fa.isIncludedIn(minimal_fa));
+  EXPECT_TRUE(minimal_fa.isIncludedIn(fa));
+}
+
+/***************************** */
+/*       MinimalHopcroft       */
 /***************************** */
-/*     MinimalBororxkcvfuihr   */
-/***************************** */ 
 
-TEST(MinimalBororxkcvfuihrTest, CourseExample) {
+TEST(minimalHopcroftTest, CourseExample) {
   static const std::vector<char> symbols = {'a','b'};
-	fa::Automaton fa = createAutomaton(6,symbols);	
+  fa::Automaton fa = createAutomaton(6, symbols);
   fa.setStateInitial(0);
   fa.setStateFinal(3);
   fa.setStateFinal(4);
   fa.addTransition(0, 'a', 1);
   fa.addTransition(0, 'b', 2);
-  fa.addTransition(1, 'a', 2);
-  fa.addTransition(1, 'b', 3);
-  fa.addTransition(2, 'a', 1);
-  fa.addTransition(2, 'b', 4);
-  fa.addTransition(3, 'a', 4);
-  fa.addTransition(3, 'b', 5);
-  fa.addTransition(4, 'a', 3);
+  fa.addTransition(1, 'a', 3);
+  fa.addTransition(1, 'b', 4);
+  fa.addTransition(2, 'a', 4);
+  fa.addTransition(2, 'b', 3);
+  fa.addTransition(3, 'a', 5);
   fa.addTransition(4, 'b', 5);
-  fa.addTransition(5, 'a', 5);
-  fa.addTransition(5, 'b', 5);
 
-  EXPECT_EQ(fa.countStates(), 6u);
-
-  EXPECT_TRUE(fa.isValid());
-  EXPECT_TRUE(fa.isDeterministic());
-  EXPECT_TRUE(fa.isComplete());
+  fa::Automaton minimal_fa = fa::Automaton::createMinimalHopcroft(fa);
+  EXPECT_TRUE(minimal_fa.isValid());
+  EXPECT_TRUE(minimal_fa.isComplete());
+  EXPECT_TRUE(minimal_fa.isDeterministic());
+  EXPECT_TRUE(fa.isIncludedIn(minimal_fa));
+  EXPECT_TRUE(minimal_fa.isIncludedIn(fa));
+  EXPECT_EQ(minimal_fa.countStates(), fa::Automaton::createMinimalMoore(fa).countStates());
+}
 
-  fa::Automaton minimal_fa = fa.createMinimalBrzozowski(fa);
+TEST(minimalHopcroftTest, SameAsMoore) {
+  static const std::vector<char> symbols = {'a','b','c'};
+  for(unsigned seed = 0; seed < 200; ++seed){
+    fa::Automaton fa = createRandomAutomaton(2 + seed % 7, symbols, 12, seed);
+    fa::Automaton moore = fa::Automaton::createMinimalMoore(fa);
+    fa::Automaton hopcroft = fa::Automaton::createMinimalHopcroft(fa);
+    EXPECT_EQ(hopcroft.getSt(), moore.getSt());
+    EXPECT_EQ(hopcroft.getInitialSt(), moore.getInitialSt());
+    EXPECT_EQ(hopcroft.getFinalSt(), moore.getFinalSt());
+    EXPECT_EQ(hopcroft.getTr(), moore.getTr());
+  }
+}
 
-  EXPECT_EQ(minimal_fa.countTransitions(), 8u);
-  EXPECT_EQ(minimal_fa.countStates(), 4u);
-  EXPECT_EQ(minimal_fa.countSymbols(), 2u);
+TEST(minimalHopcroftTest, NoInitialState) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(3, symbols);
+  fa.setStateFinal(1);
+  fa.addTransition(0, 'a', 1);
 
+  fa::Automaton minimal_fa = fa::Automaton::createMinimalHopcroft(fa);
   EXPECT_TRUE(minimal_fa.isValid());
-  EXPECT_TRUE(minimal_fa.isDeterministic());
-  EXPECT_TRUE(minimal_fa.isComplete());
+  EXPECT_EQ(minimal_fa.countStates(), 1u);
+  EXPECT_TRUE(minimal_fa.isLanguageEmpty());
+}
+
+TEST(minimalHopcroftTest, LargeCounter) {
+  // Counts the a modulo 300000, words with a multiple of 3 are accepted
+  const int nb_states = 300000;
+  fa::AutomatonBuilder builder;
+  for(int st = 0; st < nb_states; ++st){
+    builder.addTransition(st, 'a', (st + 1) % nb_states);
+    builder.addTransition(st, 'b', st);
+    if(st % 3 == 0) builder.setStateFinal(st);
+  }
+  builder.setStateInitial(0);
+
+  fa::Automaton minimal_fa = fa::Automaton::createMinimalHopcroft(builder.build());
+  EXPECT_EQ(minimal_fa.countStates(), 3u);
+  EXPECT_TRUE(minimal_fa.match("abaab"));
+  EXPECT_FALSE(minimal_fa.match("abab"));
+}
+
+TEST(minimalHopcroftTest, SameAsValmari) {
+  // Both run on the same refinable partition, on larger automata than Moore
+  static const std::vector<char> symbols = {'a','b','c','d'};
+  for(unsigned seed = 0; seed < 40; ++seed){
+    fa::Automaton fa = createRandomAutomaton(20 + seed, symbols, 60 + 2 * seed, seed);
+    fa::Automaton hopcroft = fa::Automaton::createMinimalHopcroft(fa);
+    fa::Automaton valmari = fa::Automaton::createMinimalValmari(fa, true);
+
+    EXPECT_EQ(hopcroft.countStates(), valmari.countStates());
+    EXPECT_TRUE(hopcroft.isEquivalentTo(valmari));
+    EXPECT_TRUE(hopcroft.isEquivalentTo(fa));
+  }
+}
+
+/***************************** */
+/*        MinimalValmari       */
+/***************************** */
+
+TEST(minimalValmariTest, SameAsMoore) {
+  static const std::vector<char> symbols = {'a','b','c'};
+  for(unsigned seed = 0; seed < 200; ++seed){
+    fa::Automaton fa = createRandomAutomaton(2 + seed % 7, symbols, 10, seed);
+    fa::Automaton moore = fa::Automaton::createMinimalMoore(fa);
+    fa::Automaton partial = fa::Automaton::createMinimalValmari(fa);
+    fa::Automaton complete = fa::Automaton::createMinimalValmari(fa, true);
+
+    EXPECT_TRUE(partial.isDeterministic());
+    EXPECT_TRUE(complete.isDeterministic());
+    EXPECT_TRUE(complete.isComplete());
+    EXPECT_EQ(complete.countStates(), moore.countStates());
+    EXPECT_TRUE(partial.isIncludedIn(moore));
+    EXPECT_TRUE(moore.isIncludedIn(partial));
+
+    if(!moore.isLanguageEmpty()){
+      moore.trim();
+      EXPECT_EQ(partial.countStates(), moore.countStates());
+    }
+  }
+}
+
+TEST(minimalValmariTest, NoSink) {
+  static const std::vector<char> symbols = {'a','b'};
+  fa::Automaton fa = createAutomaton(5, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(3);
+  fa.setStateFinal(4);
+  fa.addTransition(0, 'a', 1);
+  fa.addTransition(0, 'b', 2);
+  fa.addTransition(1, 'a', 3);
+  fa.addTransition(2, 'a', 4);
+
+  fa::Automaton minimal_fa = fa::Automaton::createMinimalValmari(fa);
+  EXPECT_EQ(minimal_fa.countStates(), 3u);
+  EXPECT_EQ(minimal_fa.countTransitions(), 3u);
+  EXPECT_FALSE(minimal_fa.isComplete());
+  EXPECT_TRUE(minimal_fa.match("aa"));
+  EXPECT_TRUE(minimal_fa.match("ba"));
+  EXPECT_FALSE(minimal_fa.match("ab"));
+
+  fa::Automaton with_sink = fa::Automaton::createMinimalValmari(fa, true);
+  EXPECT_EQ(with_sink.countStates(), 4u);
+  EXPECT_TRUE(with_sink.isComplete());
+  // The sink comes after the other states
+  EXPECT_TRUE(with_sink.isStateFinal(3));
+  EXPECT_FALSE(with_sink.isStateFinal(4));
+  EXPECT_EQ(with_sink.getTr().at({4, 'a'}), (std::set<int>{4}));
+}
+
+TEST(minimalValmariTest, EmptyLanguage) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(2, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(1);
+
+  fa::Automaton minimal_fa = fa::Automaton::createMinimalValmari(fa);
+  EXPECT_TRUE(minimal_fa.isValid());
+  EXPECT_EQ(minimal_fa.countStates(), 1u);
+  EXPECT_EQ(minimal_fa.countTransitions(), 0u);
+  EXPECT_TRUE(minimal_fa.isLanguageEmpty());
+
+  minimal_fa = fa::Automaton::createMinimalValmari(fa, true);
+  EXPECT_EQ(minimal_fa.countStates(), 1u);
+  EXPECT_TRUE(minimal_fa.isComplete());
+}
+
+TEST(minimalValmariTest, SparseLargeAlphabet) {
+  // Keywords over every printable symbol, Moore would complete them first
+  std::vector<char> symbols;
+  for(char c = '!'; c <= '~'; ++c) symbols.push_back(c);
+  fa::AutomatonBuilder builder;
+  for(char c : symbols) builder.addSymbol(c);
+  int next = 1;
+  builder.setStateInitial(0);
+  for(std::string word : {"if", "else", "while", "for", "return", "elif"}){
+    int st = 0;
+    for(char c : word){
+      builder.addTransition(st, c, next);
+      st = next++;
+    }
+    builder.setStateFinal(st);
+  }
+
+  fa::Automaton fa = builder.build();
+  fa::Automaton minimal_fa = fa::Automaton::createMinimalValmari(fa);
+  EXPECT_TRUE(minimal_fa.isDeterministic());
+  EXPECT_LT(minimal_fa.countTransitions(), 2 * minimal_fa.countStates());
+  for(auto word : {"if", "else", "while", "for", "return", "elif"}){
+    EXPECT_TRUE(minimal_fa.match(word));
+  }
+  EXPECT_FALSE(minimal_fa.match("el"));
+  EXPECT_EQ(minimal_fa.countStates(), fa::Automaton::createMinimalMoore(fa).countStates() - 1);
+}
+
+/***************************** */
+/*     MinimalBororxkcvfuihr   */
+/***************************** */ 
+
+TEST(MinimalBororxkcvfuihrTest, CourseExample) {
+  static const std::vector<char> symbols = {'a','b'};
+	fa::Automaton fa = createAutomaton(6,symbols);	
+  fa.setStateInitial(0);
+  fa.setStateFinal(3);
+  fa.setStateFinal(4);
+  fa.addTransition(0, 'a', 1);
+  fa.addTransition(0, 'b', 2);
+  fa.addTransition(1, 'a', 2);
+  fa.addTransition(1, 'b', 3);
+  fa.addTransition(2, 'a', 1);
+  fa.addTransition(2, 'b', 4);
+  fa.addTransition(3, 'a', 4);
+  fa.addTransition(3, 'b', 5);
+  fa.addTransition(4, 'a', 3);
+  fa.addTransition(4, 'b', 5);
+  fa.addTransition(5, 'a', 5);
+  fa.addTransition(5, 'b', 5);
+
+  EXPECT_EQ(fa.countStates(), 6u);
+
+  EXPECT_TRUE(fa.isValid());
+  EXPECT_TRUE(fa.isDeterministic());
+  EXPECT_TRUE(fa.isComplete());
+
+  fa::Automaton minimal_fa = fa.createMinimalBrzozowski(fa);
+
+  EXPECT_EQ(minimal_fa.countTransitions(), 8u);
+  EXPECT_EQ(minimal_fa.countStates(), 4u);
+  EXPECT_EQ(minimal_fa.countSymbols(), 2u);
+
+  EXPECT_TRUE(minimal_fa.isValid());
+  EXPECT_TRUE(minimal_fa.isDeterministic());
+  EXPECT_TRUE(minimal_fa.isComplete());
 }
 
 TEST(MinimalBororxkcvfuihrTest, MinimalCourseExample) {
@@ -1278,6 +1997,1370 @@ TEST(MinimalBororxkcvfuihrTest,CompleteAndDeterministic){
 	EXPECT_TRUE(minimal_fa.isIncludedIn(fa));
 }
 
+/***************************** */
+/*       TransitionTable       */
+/***************************** */
+
+TEST(transitionTableTest, Successors) {
+  static const std::vector<char> symbols = {'a','b'};
+  fa::Automaton fa = createAutomaton(0, symbols);
+  EXPECT_TRUE(fa.addState(3));
+  EXPECT_TRUE(fa.addState(7));
+  EXPECT_TRUE(fa.addState(12));
+  fa.setStateInitial(7);
+  fa.setStateFinal(12);
+  EXPECT_TRUE(fa.addTransition(3, 'a', 12));
+  EXPECT_TRUE(fa.addTransition(3, 'a', 7));
+  EXPECT_TRUE(fa.addTransition(7, 'b', 3));
+  EXPECT_TRUE(fa.addTransition(12, fa::Epsilon, 3));
+
+  fa::TransitionTable table(fa);
+
+  EXPECT_EQ(table.countStates(), 3u);
+  EXPECT_EQ(table.countColumns(), 3u);
+  EXPECT_EQ(table.indexOf(7), 1);
+  EXPECT_EQ(table.indexOf(5), -1);
+  EXPECT_EQ(table.stateAt(2), 12);
+  EXPECT_EQ(table.columnOf('c'), -1);
+  EXPECT_EQ(table.initialStates(), std::vector<int>{1});
+  EXPECT_TRUE(table.isFinal(2));
+  EXPECT_FALSE(table.isFinal(0));
+
+  auto succ = table.successors(0, 'a');
+  EXPECT_EQ(std::vector<int>(succ.begin(), succ.end()), (std::vector<int>{1, 2}));
+  EXPECT_TRUE(table.successors(0, 'b').empty());
+  EXPECT_EQ(table.successors(1, 'b').size(), 1u);
+  EXPECT_EQ(*table.successors(2, fa::Epsilon).begin(), 0);
+}
+
+TEST(transitionTableTest, SparseRows) {
+  static const std::vector<char> symbols = {'!', 'a', 'z'};
+  fa::Automaton fa = createAutomaton(4, symbols);
+  EXPECT_TRUE(fa.addTransition(1, 'z', 3));
+  EXPECT_TRUE(fa.addTransition(1, '!', 2));
+  EXPECT_TRUE(fa.addTransition(1, fa::Epsilon, 0));
+  EXPECT_TRUE(fa.addTransition(1, fa::Epsilon, 3));
+  EXPECT_TRUE(fa.addTransition(3, 'a', 3));
+
+  fa::TransitionTable table(fa);
+  EXPECT_EQ(table.countColumns(), 4u);
+  auto epsilon = table.successorsAt(1, 0);
+  EXPECT_EQ(std::vector<int>(epsilon.begin(), epsilon.end()), (std::vector<int>{0, 3}));
+  EXPECT_EQ(*table.successors(1, '!').begin(), 2);
+  EXPECT_EQ(*table.successors(1, 'z').begin(), 3);
+  EXPECT_TRUE(table.successors(1, 'a').empty());
+  EXPECT_EQ(*table.successors(3, 'a').begin(), 3);
+  for(std::size_t column = 0; column < table.countColumns(); ++column){
+    EXPECT_TRUE(table.successorsAt(0, column).empty());
+    EXPECT_TRUE(table.successorsAt(2, column).empty());
+  }
+}
+
+TEST(transitionTableTest, RowCells) {
+  static const std::vector<char> symbols = {'!', 'a', 'z'};
+  fa::Automaton fa = createAutomaton(4, symbols);
+  EXPECT_TRUE(fa.addTransition(1, 'z', 3));
+  EXPECT_TRUE(fa.addTransition(1, '!', 2));
+  EXPECT_TRUE(fa.addTransition(1, fa::Epsilon, 0));
+  EXPECT_TRUE(fa.addTransition(1, fa::Epsilon, 3));
+  EXPECT_TRUE(fa.addTransition(3, 'a', 3));
+
+  fa::TransitionTable table(fa);
+  std::vector<std::size_t> columns;
+  std::vector<int> targets;
+  for(std::size_t cell = table.firstCell(1); cell < table.firstCell(2); ++cell){
+    columns.push_back(table.cellColumn(cell));
+    for(auto to : table.cellTargets(cell)) targets.push_back(to);
+  }
+  EXPECT_EQ(columns, (std::vector<std::size_t>{0, 1, 3}));
+  EXPECT_EQ(targets, (std::vector<int>{0, 3, 2, 3}));
+  auto row = table.rowTargets(1);
+  EXPECT_EQ(std::vector<int>(row.begin(), row.end()), targets);
+  EXPECT_TRUE(table.rowTargets(0).empty());
+  EXPECT_TRUE(table.rowTargets(2).empty());
+  EXPECT_EQ(table.rowTargets(3).size(), 1u);
+}
+
+TEST(transitionTableTest, Empty) {
+  fa::Automaton fa;
+  fa::TransitionTable table(fa);
+  EXPECT_EQ(table.countStates(), 0u);
+  EXPECT_EQ(table.countColumns(), 1u);
+  EXPECT_TRUE(table.initialStates().empty());
+}
+
+/***************************** */
+/*     CreateIntersection      */
+/***************************** */
+
+TEST(createIntersectionTest, Match) {
+  static const std::vector<char> symbols = {'a','b'};
+  // Words ending with 'a'
+  fa::Automaton lhs = createAutomaton(2, symbols);
+  lhs.setStateInitial(0);
+  lhs.setStateFinal(1);
+  EXPECT_TRUE(lhs.addTransition(0, 'a', 0));
+  EXPECT_TRUE(lhs.addTransition(0, 'b', 0));
+  EXPECT_TRUE(lhs.addTransition(0, 'a', 1));
+  // Words starting with 'b'
+  fa::Automaton rhs = createAutomaton(3, symbols);
+  rhs.setStateInitial(2);
+  rhs.setStateFinal(0);
+  EXPECT_TRUE(rhs.addTransition(2, 'b', 0));
+  EXPECT_TRUE(rhs.addTransition(0, 'a', 0));
+  EXPECT_TRUE(rhs.addTransition(0, 'b', 0));
+
+  fa::Automaton inter = fa::Automaton::createIntersection(lhs, rhs);
+
+  EXPECT_TRUE(inter.isValid());
+  EXPECT_TRUE(inter.match("ba"));
+  EXPECT_TRUE(inter.match("bbba"));
+  EXPECT_FALSE(inter.match("a"));
+  EXPECT_FALSE(inter.match("bab"));
+  EXPECT_FALSE(inter.isLanguageEmpty());
+}
+
+TEST(createIntersectionTest, Empty) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton lhs = createAutomaton(1, symbols);
+  lhs.setStateInitial(0);
+  lhs.setStateFinal(0);
+  fa::Automaton rhs = createAutomaton(2, symbols);
+  rhs.setStateInitial(0);
+  rhs.setStateFinal(1);
+  EXPECT_TRUE(rhs.addTransition(0, 'a', 1));
+
+  fa::Automaton inter = fa::Automaton::createIntersection(lhs, rhs);
+
+  EXPECT_TRUE(inter.isValid());
+  EXPECT_TRUE(inter.isLanguageEmpty());
+}
+
+TEST(createIntersectionTest, Epsilon) {
+  fa::Automaton fa = createEpsilonChain();
+  fa::Automaton inter = fa::Automaton::createIntersection(fa, fa);
+  EXPECT_TRUE(inter.match("a"));
+  EXPECT_FALSE(inter.match(""));
+  EXPECT_FALSE(inter.hasEpsilonTransition());
+
+  fa::Automaton thompson = createThompson();
+  fa::Automaton third = createThirdFromEnd();
+  inter = fa::Automaton::createIntersection(thompson, third);
+  for(auto word : {"aab", "abb", "aaab", "abab", "ab", "b", "bab", ""}){
+    EXPECT_EQ(inter.match(word), thompson.match(word) && third.match(word)) << word;
+  }
+}
+
+/***************************** */
+/*  HasEmptyIntersectionWith   */
+/***************************** */
+
+TEST(hasEmptyIntersectionWithTest, Witness) {
+  static const std::vector<char> symbols = {'a','b'};
+  // Words ending with 'a'
+  fa::Automaton lhs = createAutomaton(2, symbols);
+  lhs.setStateInitial(0);
+  lhs.setStateFinal(1);
+  lhs.addTransition(0, 'a', 0);
+  lhs.addTransition(0, 'b', 0);
+  lhs.addTransition(0, 'a', 1);
+  // Words starting with 'b'
+  fa::Automaton rhs = createAutomaton(3, symbols);
+  rhs.setStateInitial(2);
+  rhs.setStateFinal(0);
+  rhs.addTransition(2, 'b', 0);
+  rhs.addTransition(0, 'a', 0);
+  rhs.addTransition(0, 'b', 0);
+
+  std::string witness;
+  EXPECT_FALSE(lhs.hasEmptyIntersectionWith(rhs, witness));
+  EXPECT_EQ(witness, "ba");
+  EXPECT_FALSE(lhs.hasEmptyIntersectionWith(rhs));
+}
+
+TEST(hasEmptyIntersectionWithTest, EmptyWordWitness) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(1, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(0);
+
+  std::string witness = "unchanged";
+  EXPECT_FALSE(fa.hasEmptyIntersectionWith(fa, witness));
+  EXPECT_EQ(witness, "");
+}
+
+TEST(hasEmptyIntersectionWithTest, DisjointAlphabets) {
+  fa::Automaton lhs = createAutomaton(2, {'a'});
+  lhs.setStateInitial(0);
+  lhs.setStateFinal(1);
+  lhs.addTransition(0, 'a', 1);
+  fa::Automaton rhs = createAutomaton(2, {'b'});
+  rhs.setStateInitial(0);
+  rhs.setStateFinal(1);
+  rhs.addTransition(0, 'b', 1);
+
+  std::string witness = "unchanged";
+  EXPECT_TRUE(lhs.hasEmptyIntersectionWith(rhs, witness));
+  EXPECT_EQ(witness, "unchanged");
+}
+
+TEST(hasEmptyIntersectionWithTest, SameAsProduct) {
+  static const std::vector<char> symbols = {'a','b'};
+  for(unsigned seed = 0; seed < 200; ++seed){
+    fa::Automaton lhs = createRandomAutomaton(3 + seed % 5, symbols, 8, seed);
+    fa::Automaton rhs = createRandomAutomaton(3 + seed % 4, symbols, 8, seed + 1000);
+    fa::Automaton inter = fa::Automaton::createIntersection(lhs, rhs);
+
+    std::string witness;
+    const bool empty = lhs.hasEmptyIntersectionWith(rhs, witness);
+    EXPECT_EQ(empty, inter.isLanguageEmpty());
+    if(!empty){
+      EXPECT_TRUE(lhs.match(witness));
+      EXPECT_TRUE(rhs.match(witness));
+    }
+  }
+}
+
+TEST(hasEmptyIntersectionWithTest, StopsEarly) {
+  // The product of these rings has 10^10 pairs, a witness is one step away
+  const int nb_states = 100000;
+  auto ring = [nb_states](int b_step){
+    fa::AutomatonBuilder builder;
+    for(int st = 0; st < nb_states; ++st){
+      builder.addTransition(st, 'a', (st + 1) % nb_states);
+      builder.addTransition(st, 'b', (st + b_step) % nb_states);
+    }
+    builder.setStateInitial(0);
+    builder.setStateFinal(1);
+    return builder.build();
+  };
+  fa::Automaton lhs = ring(7);
+  fa::Automaton rhs = ring(3);
+
+  std::string witness;
+  EXPECT_FALSE(lhs.hasEmptyIntersectionWith(rhs, witness));
+  EXPECT_EQ(witness, "a");
+}
+
+TEST(hasEmptyIntersectionWithTest, Epsilon) {
+  fa::Automaton fa = createEpsilonChain();
+  std::string witness;
+  EXPECT_FALSE(fa.hasEmptyIntersectionWith(fa::Automaton::createDeterministic(fa), witness));
+  EXPECT_EQ(witness, "a");
+
+  fa::Automaton thompson = createThompson();
+  fa::Automaton third = createThirdFromEnd();
+  EXPECT_FALSE(thompson.hasEmptyIntersectionWith(third, witness));
+  EXPECT_EQ(witness.size(), 3u);
+  EXPECT_TRUE(thompson.match(witness));
+  EXPECT_TRUE(third.match(witness));
+  EXPECT_TRUE(fa.hasEmptyIntersectionWith(thompson));
+}
+
+/***************************** */
+/*         IsIncludedIn        */
+/***************************** */
+
+TEST(isIncludedInTest, Counterexample) {
+  static const std::vector<char> symbols = {'a','b'};
+  // Words ending with 'a'
+  fa::Automaton lhs = createAutomaton(2, symbols);
+  lhs.setStateInitial(0);
+  lhs.setStateFinal(1);
+  lhs.addTransition(0, 'a', 0);
+  lhs.addTransition(0, 'b', 0);
+  lhs.addTransition(0, 'a', 1);
+  // Words containing an 'a'
+  fa::Automaton rhs = createAutomaton(2, symbols);
+  rhs.setStateInitial(0);
+  rhs.setStateFinal(1);
+  rhs.addTransition(0, 'a', 1);
+  rhs.addTransition(0, 'b', 0);
+  rhs.addTransition(1, 'a', 1);
+  rhs.addTransition(1, 'b', 1);
+
+  std::string counterexample = "unchanged";
+  EXPECT_TRUE(lhs.isIncludedIn(rhs, counterexample));
+  EXPECT_EQ(counterexample, "unchanged");
+  EXPECT_FALSE(rhs.isIncludedIn(lhs, counterexample));
+  EXPECT_EQ(counterexample, "ab");
+}
+
+TEST(isIncludedInTest, MissingSymbol) {
+  fa::Automaton lhs = createAutomaton(2, {'a', 'b'});
+  lhs.setStateInitial(0);
+  lhs.setStateFinal(1);
+  lhs.addTransition(0, 'b', 1);
+  fa::Automaton rhs = createAutomaton(1, {'a'});
+  rhs.setStateInitial(0);
+  rhs.setStateFinal(0);
+  rhs.addTransition(0, 'a', 0);
+
+  std::string counterexample;
+  EXPECT_FALSE(lhs.isIncludedIn(rhs, counterexample));
+  EXPECT_EQ(counterexample, "b");
+  EXPECT_FALSE(rhs.isIncludedIn(lhs, counterexample));
+  EXPECT_EQ(counterexample, "");
+}
+
+TEST(isIncludedInTest, SameAsComplement) {
+  static const std::vector<char> symbols = {'a','b'};
+  for(unsigned seed = 0; seed < 300; ++seed){
+    fa::Automaton lhs = createRandomAutomaton(2 + seed % 4, symbols, 6, seed);
+    fa::Automaton rhs = createRandomAutomaton(2 + seed % 5, symbols, 12, seed + 1000);
+    const bool expected = fa::Automaton::createIntersection(lhs,
+      fa::Automaton::createComplement(rhs)).isLanguageEmpty();
+
+    std::string counterexample;
+    EXPECT_EQ(lhs.isIncludedIn(rhs, counterexample), expected);
+    if(!expected){
+      EXPECT_TRUE(lhs.match(counterexample));
+      EXPECT_FALSE(rhs.match(counterexample));
+      // The witness of the product is a shortest word
+      std::string shortest;
+      EXPECT_FALSE(lhs.hasEmptyIntersectionWith(fa::Automaton::createComplement(rhs), shortest));
+      EXPECT_EQ(counterexample.size(), shortest.size());
+    }
+    EXPECT_TRUE(lhs.isIncludedIn(lhs));
+  }
+}
+
+TEST(isIncludedInTest, ShortestThroughLargerSet) {
+  // The couple reached by "a" has a larger set than one met later by "ba",
+  // it must still be expanded
+  fa::Automaton lhs = createAutomaton(0, {'a', 'b'});
+  for(int st : {7, 2007, 3007}) lhs.addState(st);
+  lhs.setStateInitial(3007);
+  lhs.setStateFinal(7);
+  lhs.addTransition(3007, fa::Epsilon, 2007);
+  lhs.addTransition(3007, 'a', 7);
+  lhs.addTransition(3007, 'a', 3007);
+  lhs.addTransition(3007, 'b', 7);
+  lhs.addTransition(3007, 'b', 3007);
+  lhs.addTransition(2007, 'b', 3007);
+
+  fa::Automaton rhs = createAutomaton(2, {'a', 'b'});
+  rhs.setStateInitial(0);
+  rhs.setStateFinal(0);
+  rhs.addTransition(1, 'b', 0);
+
+  std::string counterexample;
+  EXPECT_FALSE(lhs.isIncludedIn(rhs, counterexample));
+  EXPECT_EQ(counterexample, "a");
+}
+
+TEST(isIncludedInTest, NoDeterminization) {
+  // Words whose 40th letter from the end is an 'a', its complement would
+  // have 2^40 states
+  const int n = 40;
+  fa::AutomatonBuilder builder;
+  builder.setStateInitial(0);
+  builder.setStateFinal(n);
+  builder.addTransitions({{0, 'a', 0}, {0, 'b', 0}, {0, 'a', 1}});
+  for(int st = 1; st < n; ++st){
+    builder.addTransitions({{st, 'a', st + 1}, {st, 'b', st + 1}});
+  }
+  fa::Automaton rhs = builder.build();
+
+  fa::Automaton lhs = createAutomaton(n + 1, {'a', 'b'});
+  lhs.setStateInitial(0);
+  lhs.setStateFinal(n);
+  for(int st = 0; st < n; ++st) lhs.addTransition(st, st == 0 ? 'b' : 'a', st + 1);
+
+  std::string counterexample;
+  EXPECT_FALSE(lhs.isIncludedIn(rhs, counterexample));
+  EXPECT_EQ(counterexample, "b" + std::string(n - 1, 'a'));
+
+  // a followed by 39 letters is included
+  lhs.removeTransition(0, 'b', 1);
+  lhs.addTransition(0, 'a', 1);
+  for(int st = 1; st < n; ++st) lhs.addTransition(st, 'b', st + 1);
+  EXPECT_TRUE(lhs.isIncludedIn(rhs));
+}
+
+TEST(isIncludedInTest, Epsilon) {
+  fa::Automaton fa = createEpsilonChain();
+  fa::Automaton deterministic = fa::Automaton::createDeterministic(fa);
+  EXPECT_TRUE(fa.isIncludedIn(deterministic));
+  EXPECT_TRUE(deterministic.isIncludedIn(fa));
+
+  fa::Automaton thompson = createThompson();
+  EXPECT_TRUE(thompson.isIncludedIn(fa::Automaton::createDeterministic(thompson)));
+  EXPECT_TRUE(fa::Automaton::createDeterministic(thompson).isIncludedIn(thompson));
+  std::string counterexample;
+  EXPECT_FALSE(thompson.isIncludedIn(createThirdFromEnd(), counterexample));
+  EXPECT_EQ(counterexample, "b");
+}
+
+/***************************** */
+/*        IsEquivalentTo       */
+/***************************** */
+
+TEST(isEquivalentToTest, MinimalAndDeterministic) {
+  fa::Automaton fa = createThirdFromEnd();
+  fa::Automaton dfa = fa::Automaton::createDeterministic(fa);
+  fa::Automaton minimal_fa = fa::Automaton::createMinimalHopcroft(fa);
+
+  EXPECT_TRUE(fa.isEquivalentTo(dfa));
+  EXPECT_TRUE(dfa.isEquivalentTo(minimal_fa));
+  EXPECT_TRUE(minimal_fa.isEquivalentTo(fa));
+  EXPECT_TRUE(fa.isEquivalentTo(fa));
+}
+
+TEST(isEquivalentToTest, Counterexample) {
+  fa::Automaton fa = createThirdFromEnd();
+  // Words whose second letter from the end is an 'a'
+  fa::Automaton other = createAutomaton(3, {'a', 'b'});
+  other.setStateInitial(0);
+  other.setStateFinal(2);
+  other.addTransition(0, 'a', 0);
+  other.addTransition(0, 'b', 0);
+  other.addTransition(0, 'a', 1);
+  other.addTransition(1, 'a', 2);
+  other.addTransition(1, 'b', 2);
+
+  std::string counterexample = "unchanged";
+  EXPECT_FALSE(fa.isEquivalentTo(other, counterexample));
+  EXPECT_NE(fa.match(counterexample), other.match(counterexample));
+  EXPECT_EQ(counterexample.size(), 2u);
+}
+
+TEST(isEquivalentToTest, DifferentAlphabets) {
+  fa::Automaton lhs = createAutomaton(1, {'a'});
+  lhs.setStateInitial(0);
+  lhs.setStateFinal(0);
+  lhs.addTransition(0, 'a', 0);
+  fa::Automaton rhs = createAutomaton(1, {'a', 'b'});
+  rhs.setStateInitial(0);
+  rhs.setStateFinal(0);
+  rhs.addTransition(0, 'a', 0);
+
+  // b is not accepted by any of them
+  EXPECT_TRUE(lhs.isEquivalentTo(rhs));
+  rhs.addTransition(0, 'b', 0);
+  std::string counterexample;
+  EXPECT_FALSE(lhs.isEquivalentTo(rhs, counterexample));
+  EXPECT_EQ(counterexample, "b");
+}
+
+TEST(isEquivalentToTest, SameAsInclusions) {
+  static const std::vector<char> symbols = {'a','b'};
+  for(unsigned seed = 0; seed < 300; ++seed){
+    fa::Automaton lhs = createRandomAutomaton(2 + seed % 4, symbols, 8, seed);
+    fa::Automaton rhs = (seed % 3 == 0)
+      ? fa::Automaton::createMinimalMoore(lhs)
+      : createRandomAutomaton(2 + seed % 3, symbols, 8, seed + 1000);
+    const bool expected = lhs.isIncludedIn(rhs) && rhs.isIncludedIn(lhs);
+
+    std::string counterexample;
+    EXPECT_EQ(lhs.isEquivalentTo(rhs, counterexample), expected);
+    if(!expected){
+      EXPECT_NE(lhs.match(counterexample), rhs.match(counterexample));
+    }
+  }
+}
+
+TEST(isEquivalentToTest, Epsilon) {
+  fa::Automaton fa = createEpsilonChain();
+  EXPECT_TRUE(fa.isEquivalentTo(fa::Automaton::createDeterministic(fa)));
+
+  fa::Automaton thompson = createThompson();
+  EXPECT_TRUE(thompson.isEquivalentTo(fa::Automaton::createDeterministic(thompson)));
+  EXPECT_TRUE(fa::Automaton::createWithoutEpsilon(thompson).isEquivalentTo(thompson));
+  std::string counterexample;
+  fa::Automaton mirror = fa::Automaton::createMirror(thompson);
+  EXPECT_FALSE(thompson.isEquivalentTo(mirror, counterexample));
+  EXPECT_NE(thompson.match(counterexample), mirror.match(counterexample));
+}
+
+/***************************** */
+/*        SymbolClasses        */
+/***************************** */
+
+TEST(symbolClassesTest, MergeEquivalentSymbols) {
+  static const std::vector<char> symbols = {'a','b','c','d'};
+  fa::Automaton fa = createAutomaton(2, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(1);
+  // 'a' and 'c' behave identically, 'b' alone, 'd' labels nothing
+  EXPECT_TRUE(fa.addTransition(0, 'a', 1));
+  EXPECT_TRUE(fa.addTransition(0, 'c', 1));
+  EXPECT_TRUE(fa.addTransition(1, 'a', 0));
+  EXPECT_TRUE(fa.addTransition(1, 'c', 0));
+  EXPECT_TRUE(fa.addTransition(0, 'b', 0));
+
+  fa::SymbolClasses classes(fa);
+
+  EXPECT_EQ(classes.countClasses(), 4u);
+  EXPECT_EQ(classes.classOf('a'), classes.classOf('c'));
+  EXPECT_NE(classes.classOf('a'), classes.classOf('b'));
+  EXPECT_NE(classes.classOf('d'), 0u);
+  EXPECT_EQ(classes.classOf('z'), 0u);
+  EXPECT_EQ(classes.classOf(fa::Epsilon), 0u);
+  EXPECT_EQ(classes.representative(classes.classOf('c')), 'a');
+}
+
+TEST(symbolClassesTest, CompiledDfaColumns) {
+  static const std::vector<char> symbols = {'a','b','c','d','e'};
+  fa::Automaton fa = createAutomaton(2, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(1);
+  for(char symbol : symbols){
+    EXPECT_TRUE(fa.addTransition(0, symbol, 1));
+  }
+
+  fa::CompiledDfa dfa = fa.freeze();
+
+  EXPECT_EQ(dfa.countClasses(), 2u);
+  EXPECT_TRUE(dfa.match("c"));
+  EXPECT_TRUE(dfa.match("e"));
+  EXPECT_FALSE(dfa.match("f"));
+  EXPECT_FALSE(dfa.match("ab"));
+}
+
+/***************************** */
+/*          CompiledDfa        */
+/***************************** */
+
+TEST(compiledDfaTest, SameLanguage) {
+  static const std::vector<char> symbols = {'a','b'};
+  fa::Automaton fa = createAutomaton(6, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(3);
+  fa.setStateFinal(4);
+  fa.addTransition(0, 'a', 1);
+  fa.addTransition(0, 'b', 2);
+  fa.addTransition(1, 'a', 2);
+  fa.addTransition(1, 'b', 3);
+  fa.addTransition(2, 'a', 1);
+  fa.addTransition(2, 'b', 4);
+  fa.addTransition(3, 'a', 4);
+  fa.addTransition(4, 'a', 3);
+
+  fa::CompiledDfa dfa = fa.freeze();
+
+  EXPECT_EQ(dfa.countStates(), 6u);
+  for(auto word : {"", "a", "ab", "bb", "aab", "aba", "abaa", "abb", "abab", "c", "abc"}){
+    EXPECT_EQ(fa.match(word), dfa.match(word));
+  }
+}
+
+TEST(compiledDfaTest, DeadState) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(2, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(1);
+  fa.addTransition(0, 'a', 1);
+
+  fa::CompiledDfa dfa = fa.freeze();
+
+  EXPECT_EQ(dfa.next(dfa.initialState(), 'a'), 1);
+  EXPECT_EQ(dfa.next(1, 'a'), fa::CompiledDfa::Dead);
+  EXPECT_FALSE(dfa.isFinal(fa::CompiledDfa::Dead));
+  EXPECT_TRUE(dfa.match("a"));
+  EXPECT_FALSE(dfa.match("aa"));
+  EXPECT_FALSE(dfa.match(""));
+}
+
+/***************************** */
+/*           StateSet          */
+/***************************** */
+
+TEST(stateSetTest, InsertEraseCount) {
+  fa::StateSet set(130);
+  EXPECT_TRUE(set.empty());
+  set.insert(0);
+  set.insert(64);
+  set.insert(129);
+  EXPECT_TRUE(set.contains(64));
+  EXPECT_FALSE(set.contains(63));
+  EXPECT_EQ(set.count(), 3u);
+  set.erase(64);
+  EXPECT_FALSE(set.contains(64));
+
+  std::vector<std::size_t> indices;
+  set.forEach([&](std::size_t i){ indices.push_back(i); });
+  EXPECT_EQ(indices, (std::vector<std::size_t>{0, 129}));
+
+  set.clear();
+  EXPECT_TRUE(set.empty());
+}
+
+TEST(stateSetTest, MergeIntersects) {
+  fa::StateSet lhs(70);
+  fa::StateSet rhs(70);
+  lhs.insert(3);
+  rhs.insert(68);
+  EXPECT_FALSE(lhs.intersects(rhs));
+  lhs.merge(rhs);
+  EXPECT_TRUE(lhs.intersects(rhs));
+  EXPECT_EQ(lhs.count(), 2u);
+}
+
+/***************************** */
+/*         SubsetTable         */
+/***************************** */
+
+TEST(subsetTableTest, InsertFind) {
+  fa::SubsetTable table;
+  const std::vector<int> empty;
+  const std::vector<int> first = {0, 3, 5};
+  const std::vector<int> second = {3, 5};
+
+  EXPECT_EQ(table.insert(first, fa::SubsetTable::hashOf(first)), std::make_pair(0, true));
+  EXPECT_EQ(table.insert(empty, fa::SubsetTable::hashOf(empty)), std::make_pair(1, true));
+  EXPECT_EQ(table.insert(second, fa::SubsetTable::hashOf(second)), std::make_pair(2, true));
+  EXPECT_EQ(table.insert(first, fa::SubsetTable::hashOf(first)), std::make_pair(0, false));
+  EXPECT_EQ(table.size(), 3u);
+
+  EXPECT_EQ(table.find(second, fa::SubsetTable::hashOf(second)), 2);
+  const std::vector<int> unknown = {0, 5};
+  EXPECT_EQ(table.find(unknown, fa::SubsetTable::hashOf(unknown)), -1);
+
+  auto range = table.subset(0);
+  EXPECT_EQ(std::vector<int>(range.begin(), range.end()), first);
+  EXPECT_TRUE(table.subset(1).empty());
+}
+
+TEST(subsetTableTest, HashIgnoresOrder) {
+  std::uint64_t hash = 0;
+  for(int st : {5, 0, 3}) hash += fa::SubsetTable::hashOf(st);
+  EXPECT_EQ(hash, fa::SubsetTable::hashOf(std::vector<int>{0, 3, 5}));
+}
+
+TEST(subsetTableTest, Grow) {
+  fa::SubsetTable table;
+  for(int i = 0; i < 10000; ++i){
+    const std::vector<int> subset = {i, i + 1, 2 * i + 7};
+    EXPECT_EQ(table.insert(subset, fa::SubsetTable::hashOf(subset)).first, i);
+  }
+  for(int i = 0; i < 10000; ++i){
+    const std::vector<int> subset = {i, i + 1, 2 * i + 7};
+    EXPECT_EQ(table.find(subset, fa::SubsetTable::hashOf(subset)), i);
+  }
+  EXPECT_GT(table.memoryUsage(), 10000 * 3 * sizeof(int));
+
+  table.clear();
+  EXPECT_EQ(table.size(), 0u);
+}
+
+/***************************** */
+/*       EpsilonClosures       */
+/***************************** */
+
+TEST(epsilonClosuresTest, Trivial) {
+  fa::Automaton fa = createThirdFromEnd();
+  const fa::TransitionTable table(fa);
+  const fa::EpsilonClosures closures(table);
+
+  EXPECT_TRUE(closures.trivial());
+  for(std::size_t st = 0; st < table.countStates(); ++st){
+    auto closure = closures.closure(st);
+    EXPECT_EQ(std::vector<int>(closure.begin(), closure.end()), std::vector<int>{static_cast<int>(st)});
+  }
+}
+
+TEST(epsilonClosuresTest, Components) {
+  fa::Automaton fa = createThompson();
+  const fa::TransitionTable table(fa);
+  const fa::EpsilonClosures closures(table);
+
+  EXPECT_FALSE(closures.trivial());
+  auto closure = [&](int st){
+    auto range = closures.closure(table.indexOf(st));
+    return std::vector<int>(range.begin(), range.end());
+  };
+  // 1 and 7 are in the same component through 7 -> 1
+  EXPECT_EQ(closure(0), (std::vector<int>{0, 1, 2, 5, 8}));
+  EXPECT_EQ(closure(4), (std::vector<int>{1, 2, 4, 5, 7, 8}));
+  EXPECT_EQ(closure(7), (std::vector<int>{1, 2, 5, 7, 8}));
+  EXPECT_EQ(closure(3), (std::vector<int>{3}));
+  EXPECT_EQ(closures.closure(std::vector<int>{3, 6}), (std::vector<int>{1, 2, 3, 5, 6, 7, 8}));
+
+  fa::StateSet set(table.countStates());
+  set.insert(table.indexOf(6));
+  closures.close(set);
+  EXPECT_EQ(set.count(), 6u);
+}
+
+TEST(epsilonClosuresTest, ClosedSuccessors) {
+  fa::Automaton fa = createThompson();
+  const fa::TransitionTable table(fa);
+  const fa::EpsilonClosures closures(table);
+  std::vector<char> marks(table.countStates(), 0);
+
+  // Appended after what is already there, sorted, marks left cleared
+  std::vector<int> out = {42};
+  const std::vector<int> initials = closures.closure(table.initialStates());
+  const std::size_t column = static_cast<std::size_t>(table.columnOf('a'));
+  std::uint64_t hash = closures.closedSuccessors(initials, table, column, marks, out);
+  EXPECT_EQ(out, (std::vector<int>{42, 1, 2, 3, 5, 6, 7, 8}));
+  EXPECT_EQ(hash, fa::SubsetTable::hashOf(std::vector<int>(out.begin() + 1, out.end())));
+  EXPECT_EQ(std::count(marks.begin(), marks.end(), 1), 0);
+
+  out.clear();
+  EXPECT_EQ(closures.closedSuccessors(std::vector<int>{3}, table, column, marks, out), 0u);
+  EXPECT_TRUE(out.empty());
+}
+
+TEST(epsilonClosuresTest, LongChain) {
+  // Deep epsilon chain, the closures are computed without recursion
+  const int nb_states = 100000;
+  fa::AutomatonBuilder builder;
+  for(int st = 0; st < nb_states; ++st){
+    builder.addTransition(st, fa::Epsilon, (st + 1) % nb_states);
+  }
+  builder.addTransition(nb_states - 1, 'a', nb_states);
+  builder.setStateInitial(0);
+  builder.setStateFinal(nb_states);
+  fa::Automaton fa = builder.build();
+
+  const fa::TransitionTable table(fa);
+  const fa::EpsilonClosures closures(table);
+  // A single cycle: one shared closure
+  EXPECT_EQ(closures.closure(0).size(), static_cast<std::size_t>(nb_states));
+  EXPECT_EQ(closures.closure(0).begin(), closures.closure(nb_states - 1).begin());
+  EXPECT_TRUE(fa.match("a"));
+  EXPECT_FALSE(fa.match(""));
+}
+
+TEST(epsilonClosuresTest, Matching) {
+  fa::Automaton fa = createThompson();
+  fa::LazyDfa lazy(fa);
+  fa::NfaSimulator masked(fa);
+  fa::NfaSimulator sparse(fa, false);
+  fa::Automaton dfa = fa::Automaton::createDeterministic(fa);
+  fa::Automaton parallel = fa::Automaton::createDeterministic(fa, 2);
+
+  EXPECT_TRUE(dfa.isDeterministic());
+  EXPECT_EQ(parallel.getTr(), dfa.getTr());
+  for(auto word : {"b", "ab", "abb", "aab", "ababab", "", "a", "ba", "bb", "abab"}){
+    EXPECT_EQ(lazy.match(word), fa.match(word));
+    EXPECT_EQ(masked.match(word), fa.match(word));
+    EXPECT_EQ(sparse.match(word), fa.match(word));
+    EXPECT_EQ(dfa.match(word), fa.match(word));
+  }
+  EXPECT_TRUE(fa.match("b"));
+  EXPECT_TRUE(fa.match("aab"));
+  EXPECT_TRUE(fa.match("abb"));
+  EXPECT_TRUE(fa.match("abab"));
+  EXPECT_FALSE(fa.match("bb"));
+  EXPECT_FALSE(fa.match("aba"));
+  EXPECT_FALSE(fa.match(""));
+
+  EXPECT_EQ(fa.readString(""), (std::set<int>{0, 1, 2, 5, 8}));
+  EXPECT_EQ(fa.makeTransition({5}, 'a'), (std::set<int>{1, 2, 5, 6, 7, 8}));
+}
+
+TEST(createWithoutEpsilonTest, SameLanguage) {
+  fa::Automaton fa = createThompson();
+  fa::Automaton without = fa::Automaton::createWithoutEpsilon(fa);
+
+  EXPECT_TRUE(without.isValid());
+  EXPECT_FALSE(without.hasEpsilonTransition());
+  EXPECT_EQ(without.getSt(), fa.getSt());
+  EXPECT_EQ(without.getInitialSt(), fa.getInitialSt());
+  EXPECT_TRUE(without.isEquivalentTo(fa::Automaton::createDeterministic(fa)));
+  for(auto word : {"b", "ab", "abb", "aab", "ababab", "", "a", "ba", "bb", "abab", "aaab"}){
+    EXPECT_EQ(without.match(word), fa.match(word));
+  }
+}
+
+TEST(createWithoutEpsilonTest, FinalThroughEpsilon) {
+  fa::Automaton fa = createAutomaton(3, {'a'});
+  fa.setStateInitial(0);
+  fa.setStateFinal(2);
+  fa.addTransition(0, fa::Epsilon, 1);
+  fa.addTransition(1, fa::Epsilon, 2);
+  fa.addTransition(2, 'a', 0);
+
+  fa::Automaton without = fa::Automaton::createWithoutEpsilon(fa);
+  EXPECT_EQ(without.getFinalSt(), (std::set<int>{0, 1, 2}));
+  EXPECT_EQ(without.countTransitions(), 3u);
+  EXPECT_TRUE(without.match(""));
+  EXPECT_TRUE(without.match("aaa"));
+}
+
+/***************************** */
+/*           LazyDfa           */
+/***************************** */
+
+TEST(lazyDfaTest, SameAsNfa) {
+  fa::Automaton fa = createThirdFromEnd();
+  fa::LazyDfa lazy(fa);
+
+  EXPECT_EQ(lazy.countStates(), 0u);
+  for(auto word : {"abb", "aab", "babb", "bbbaaa", "", "a", "bab", "abbb", "acb", "aaaa"}){
+    EXPECT_EQ(lazy.match(word), fa.match(word));
+  }
+  // Only the subsets met so far are built
+  EXPECT_LE(lazy.countStates(), 8u);
+  EXPECT_EQ(lazy.countFlushes(), 0u);
+}
+
+TEST(lazyDfaTest, StepByStep) {
+  fa::Automaton fa = createThirdFromEnd();
+  fa::LazyDfa lazy(fa);
+
+  int state = lazy.start();
+  EXPECT_FALSE(lazy.isFinal(state));
+  for(char c : std::string("abb")) state = lazy.next(state, c);
+  EXPECT_TRUE(lazy.isFinal(state));
+  EXPECT_EQ(lazy.next(state, 'c'), fa::LazyDfa::Dead);
+  EXPECT_EQ(lazy.next(fa::LazyDfa::Dead, 'a'), fa::LazyDfa::Dead);
+  EXPECT_FALSE(lazy.isFinal(fa::LazyDfa::Dead));
+
+  // Cached transitions are reused
+  const std::size_t states = lazy.countStates();
+  EXPECT_TRUE(lazy.match("abb"));
+  EXPECT_EQ(lazy.countStates(), states);
+}
+
+TEST(lazyDfaTest, Budget) {
+  // Words whose 20th letter from the end is an 'a', 2^20 subsets in full
+  const int n = 20;
+  fa::AutomatonBuilder builder;
+  builder.setStateInitial(0);
+  builder.setStateFinal(n);
+  builder.addTransitions({{0, 'a', 0}, {0, 'b', 0}, {0, 'a', 1}});
+  for(int st = 1; st < n; ++st){
+    builder.addTransitions({{st, 'a', st + 1}, {st, 'b', st + 1}});
+  }
+  fa::Automaton fa = builder.build();
+  fa::NfaSimulator simulator(fa);
+
+  const std::size_t budget = 64 * 1024;
+  fa::LazyDfa lazy(fa, budget);
+  std::mt19937 gen(7);
+  std::string word;
+  for(int i = 0; i < 20000; ++i) word.push_back(gen() % 2 ? 'a' : 'b');
+
+  for(std::size_t length : {0, 1, 20, 21, 500, 20000}){
+    const std::string prefix = word.substr(0, length);
+    EXPECT_EQ(lazy.match(prefix), simulator.match(prefix));
+  }
+  EXPECT_GT(lazy.countFlushes(), 0u);
+  // One state may be added over the budget before the next flush
+  EXPECT_LE(lazy.memoryUsage(), 4 * budget);
+}
+
+TEST(lazyDfaTest, DeadKeepsCache) {
+  // Words whose third letter from the end is an 'a', followed by a 'c'
+  fa::AutomatonBuilder builder;
+  builder.setStateInitial(0);
+  builder.setStateFinal(4);
+  builder.addTransitions({{0, 'a', 0}, {0, 'b', 0}, {0, 'a', 1}, {3, 'c', 4}});
+  builder.addTransitions({{1, 'a', 2}, {1, 'b', 2}, {2, 'a', 3}, {2, 'b', 3}});
+  fa::Automaton fa = builder.build();
+
+  // Over budget as soon as a state exists
+  fa::LazyDfa lazy(fa, 1);
+  const int st = lazy.next(lazy.start(), 'a');
+  const std::size_t flushes = lazy.countFlushes();
+  const std::size_t states = lazy.countStates();
+
+  // Dead costs no memory, the cache is kept and st stays valid
+  EXPECT_EQ(lazy.next(st, 'c'), fa::LazyDfa::Dead);
+  EXPECT_EQ(lazy.countFlushes(), flushes);
+  EXPECT_EQ(lazy.countStates(), states);
+  EXPECT_EQ(lazy.next(st, 'c'), fa::LazyDfa::Dead);
+  EXPECT_EQ(lazy.countFlushes(), flushes);
+}
+
+TEST(lazyDfaTest, NoInitialState) {
+  fa::Automaton fa = createAutomaton(2, {'a'});
+  fa.setStateFinal(1);
+  fa.addTransition(0, 'a', 1);
+  fa::LazyDfa lazy(fa);
+
+  EXPECT_EQ(lazy.start(), fa::LazyDfa::Dead);
+  EXPECT_FALSE(lazy.match(""));
+  EXPECT_FALSE(lazy.match("a"));
+}
+
+/***************************** */
+/*         NfaSimulator        */
+/***************************** */
+
+TEST(nfaSimulatorTest, MasksAndSparse) {
+  fa::Automaton fa = createThirdFromEnd();
+  fa::NfaSimulator masked(fa);
+  fa::NfaSimulator sparse(fa, false);
+
+  EXPECT_TRUE(masked.hasMasks());
+  EXPECT_FALSE(sparse.hasMasks());
+  for(auto word : {"abb", "aab", "babb", "bbbaaa", "", "a", "bab", "abbb", "acb"}){
+    EXPECT_EQ(masked.match(word), sparse.match(word));
+  }
+  EXPECT_TRUE(masked.match("bbabb"));
+  EXPECT_FALSE(masked.match("bbbbab"));
+}
+
+TEST(nfaSimulatorTest, Step) {
+  fa::Automaton fa = createThirdFromEnd();
+  fa::NfaSimulator simulator(fa);
+  fa::StateSet current(simulator.countStates());
+  fa::StateSet next(simulator.countStates());
+
+  simulator.start(current);
+  simulator.step(current, 'a', next);
+  EXPECT_EQ(next.count(), 2u);
+  EXPECT_FALSE(simulator.isAccepting(next));
+  simulator.step(next, 'c', current);
+  EXPECT_TRUE(current.empty());
+}
+
+TEST(readStringTest, NonDeterministic) {
+  fa::Automaton fa = createThirdFromEnd();
+  EXPECT_EQ(fa.readString("aab"), (std::set<int>{0, 1, 3}));
+  EXPECT_EQ(fa.readString("b"), (std::set<int>{3}));
+  EXPECT_TRUE(fa.readString("bc").empty());
+  EXPECT_FALSE(fa.match("abbb"));
+  EXPECT_TRUE(fa.match("babb"));
+}
+
+/***************************** */
+/*           Matcher           */
+/***************************** */
+
+TEST(matcherTest, ChunksSameAsMatch) {
+  fa::Automaton nfa = createThirdFromEnd();
+  fa::Automaton dfa = fa::Automaton::createDeterministic(nfa);
+  for(const fa::Automaton* fa : {&nfa, &dfa}){
+    fa::Matcher matcher(*fa);
+    for(std::string word : {"abb", "aab", "babb", "bbbaaa", "", "bab", "abbb", "acb", "bbabbab"}){
+      // Every split of the word in two chunks
+      for(std::size_t cut = 0; cut <= word.size(); ++cut){
+        matcher.reset();
+        matcher.feed(word.data(), cut);
+        matcher.feed(word.data() + cut, word.size() - cut);
+        EXPECT_EQ(matcher.isAccepting(), fa->match(word)) << word << " " << cut;
+      }
+    }
+  }
+}
+
+TEST(matcherTest, ByteByByte) {
+  fa::Automaton fa = createThompson();
+  fa::Matcher matcher(fa);
+  EXPECT_FALSE(matcher.isAccepting());
+  std::string word = "abaabab";
+  for(std::size_t i = 0; i < word.size(); ++i){
+    matcher.feed(word.substr(i, 1));
+    EXPECT_EQ(matcher.isAccepting(), fa.match(word.substr(0, i + 1)));
+  }
+  matcher.feed("c");
+  EXPECT_TRUE(matcher.isDead());
+  EXPECT_FALSE(matcher.isAccepting());
+  matcher.feed("b");
+  EXPECT_FALSE(matcher.isAccepting());
+
+  matcher.reset();
+  EXPECT_FALSE(matcher.isDead());
+  matcher.feed("ab");
+  EXPECT_TRUE(matcher.isAccepting());
+}
+
+TEST(matcherTest, Dead) {
+  std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(2, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(1);
+  fa.addTransition(0, 'a', 1);
+  fa::Matcher matcher(fa);
+  matcher.feed("a");
+  EXPECT_TRUE(matcher.isAccepting());
+  matcher.feed("a");
+  EXPECT_TRUE(matcher.isDead());
+  matcher.feed("aaaa");
+  EXPECT_FALSE(matcher.isAccepting());
+
+  // No initial state
+  fa::Matcher none(createAutomaton(2, symbols));
+  EXPECT_TRUE(none.isDead());
+  none.feed("");
+  EXPECT_FALSE(none.isAccepting());
+}
+
+/***************************** */
+/*           Searcher          */
+/***************************** */
+
+static std::vector<fa::Searcher::Match> findAllNaive(const fa::Automaton& fa, const std::string& text, fa::Searcher::Kind kind){
+  std::vector<fa::Searcher::Match> matches;
+  std::size_t from = 0;
+  while(from <= text.size()){
+    bool found = false;
+    for(std::size_t start = from; start <= text.size() && !found; ++start){
+      for(std::size_t end = start; end <= text.size(); ++end){
+        if(fa.match(text.substr(start, end - start))){
+          if(!found) matches.push_back({start, end});
+          found = true;
+          matches.back().end = end;
+          if(kind == fa::Searcher::Kind::LeftmostFirst) break;
+        }
+      }
+    }
+    if(!found) break;
+    from = matches.back().end > matches.back().start ? matches.back().end : matches.back().end + 1;
+  }
+  return matches;
+}
+
+static void expectSameMatches(const std::vector<fa::Searcher::Match>& actual, const std::vector<fa::Searcher::Match>& expected, const std::string& text){
+  ASSERT_EQ(actual.size(), expected.size()) << text;
+  for(std::size_t i = 0; i < actual.size(); ++i){
+    EXPECT_EQ(actual[i].start, expected[i].start) << text;
+    EXPECT_EQ(actual[i].end, expected[i].end) << text;
+  }
+}
+
+TEST(searcherTest, LeftmostLongest) {
+  // abcd|c
+  std::vector<char> symbols = {'a', 'b', 'c', 'd'};
+  fa::Automaton fa = createAutomaton(5, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(4);
+  fa.addTransition(0, 'a', 1);
+  fa.addTransition(1, 'b', 2);
+  fa.addTransition(2, 'c', 3);
+  fa.addTransition(3, 'd', 4);
+  fa.addTransition(0, 'c', 4);
+
+  fa::Searcher searcher(fa);
+  fa::Searcher::Match match;
+  ASSERT_TRUE(searcher.find("xxabcdc", match));
+  EXPECT_EQ(match.start, 2u);
+  EXPECT_EQ(match.end, 6u);
+  expectSameMatches(searcher.findAll("xxabcdc"), {{2, 6}, {6, 7}}, "xxabcdc");
+  expectSameMatches(searcher.findAll("abcabcd"), {{2, 3}, {3, 7}}, "abcabcd");
+  EXPECT_FALSE(searcher.find("abdab", match));
+  EXPECT_TRUE(searcher.findAll("").empty());
+}
+
+TEST(searcherTest, LeftmostFirst) {
+  fa::Automaton fa = createThompson();
+  fa::Searcher searcher(fa);
+  // (ab|a)*b: the first end from the leftmost start
+  expectSameMatches(searcher.findAll("aabab", fa::Searcher::Kind::LeftmostFirst), {{0, 3}, {3, 5}}, "aabab");
+  expectSameMatches(searcher.findAll("aabab", fa::Searcher::Kind::LeftmostLongest), {{0, 5}}, "aabab");
+}
+
+TEST(searcherTest, OutOfAlphabet) {
+  fa::Automaton fa = createThirdFromEnd();
+  fa::Searcher searcher(fa);
+  expectSameMatches(searcher.findAll("abb\naba-aab"), {{0, 3}, {4, 7}, {8, 11}}, "abb\naba-aab");
+}
+
+TEST(searcherTest, EmptyMatches) {
+  // a*
+  std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(1, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(0);
+  fa.addTransition(0, 'a', 0);
+
+  fa::Searcher searcher(fa);
+  expectSameMatches(searcher.findAll("baab"), {{0, 0}, {1, 3}, {3, 3}, {4, 4}}, "baab");
+  expectSameMatches(searcher.findAll("baab", fa::Searcher::Kind::LeftmostFirst),
+    {{0, 0}, {1, 1}, {2, 2}, {3, 3}, {4, 4}}, "baab");
+  expectSameMatches(searcher.findAll(""), {{0, 0}}, "");
+}
+
+TEST(searcherTest, LongText) {
+  // Only "a", non-deterministic so the determinization adds a sink
+  fa::Automaton fa = createAutomaton(3, {'a', 'b'});
+  fa.setStateInitial(0);
+  fa.setStateFinal(1);
+  fa.setStateFinal(2);
+  fa.addTransition(0, 'a', 1);
+  fa.addTransition(0, 'a', 2);
+
+  // A match that cannot grow ends the forward run at Dead, instead of
+  // running through the sink to the end of the text
+  fa::Searcher searcher(fa);
+  const fa::CompiledDfa& forward = searcher.forwardDfa();
+  EXPECT_EQ(forward.countStates(), 2u);
+  const int st = forward.next(forward.initialState(), 'a');
+  ASSERT_NE(st, fa::CompiledDfa::Dead);
+  EXPECT_TRUE(forward.isFinal(st));
+  EXPECT_EQ(forward.next(st, 'a'), fa::CompiledDfa::Dead);
+  EXPECT_EQ(forward.next(st, 'b'), fa::CompiledDfa::Dead);
+  EXPECT_EQ(forward.next(forward.initialState(), 'b'), fa::CompiledDfa::Dead);
+
+  std::string text;
+  for(int i = 0; i < 20000; ++i) text += "ab";
+  std::vector<fa::Searcher::Match> matches = searcher.findAll(text);
+  ASSERT_EQ(matches.size(), 20000u);
+  EXPECT_EQ(matches.back().start, text.size() - 2);
+  EXPECT_EQ(matches.back().end, text.size() - 1);
+}
+
+TEST(searcherTest, SameAsNaive) {
+  std::vector<char> symbols = {'a', 'b'};
+  std::mt19937 gen(5);
+  for(unsigned seed = 0; seed < 30; ++seed){
+    fa::Automaton fa = createRandomAutomaton(2 + seed % 5, symbols, 8, seed);
+    fa::Searcher searcher(fa);
+    for(int i = 0; i < 5; ++i){
+      std::string text;
+      std::size_t length = gen() % 16;
+      for(std::size_t j = 0; j < length; ++j){
+        text.push_back("abc"[gen() % 3]);
+      }
+      for(auto kind : {fa::Searcher::Kind::LeftmostFirst, fa::Searcher::Kind::LeftmostLongest}){
+        expectSameMatches(searcher.findAll(text, kind), findAllNaive(fa, text, kind), text);
+      }
+    }
+  }
+}
+
+/***************************** */
+/*           MatchAll          */
+/***************************** */
+
+static std::vector<std::string> createWords(std::size_t count, unsigned seed){
+  std::mt19937 gen(seed);
+  std::vector<std::string> words(count);
+  for(auto& word : words){
+    std::size_t length = gen() % 12;
+    for(std::size_t i = 0; i < length; ++i){
+      word.push_back("abc"[gen() % 3]);
+    }
+  }
+  return words;
+}
+
+TEST(matchAllTest, SameAsMatch) {
+  fa::Automaton nfa = createThirdFromEnd();
+  fa::Automaton dfa = fa::Automaton::createDeterministic(nfa);
+  std::vector<std::string> words = createWords(200, 1);
+  std::vector<std::string_view> views(words.begin(), words.end());
+
+  for(const fa::Automaton* fa : {&nfa, &dfa}){
+    std::vector<bool> matched = fa->matchAll(views, 1);
+    ASSERT_EQ(matched.size(), words.size());
+    for(std::size_t i = 0; i < words.size(); ++i){
+      EXPECT_EQ(matched[i], fa->match(words[i])) << words[i];
+    }
+  }
+}
+
+TEST(matchAllTest, Epsilon) {
+  fa::Automaton fa = createThompson();
+  std::vector<std::string_view> words = {"b", "ab", "abab", "aab", "abb", "", "ba", "bb"};
+  EXPECT_EQ(fa.matchAll(words), (std::vector<bool>{true, true, true, true, true, false, false, false}));
+}
+
+TEST(matchAllTest, ThreadsSameResult) {
+  fa::Automaton nfa = createThirdFromEnd();
+  fa::Automaton dfa = fa::Automaton::createDeterministic(nfa);
+  std::vector<std::string> words = createWords(10000, 2);
+  std::vector<std::string_view> views(words.begin(), words.end());
+
+  for(const fa::Automaton* fa : {&nfa, &dfa}){
+    std::vector<bool> expected = fa->matchAll(views, 1);
+    for(unsigned threads : {0u, 2u, 3u, 8u}){
+      EXPECT_EQ(fa->matchAll(views, threads), expected);
+    }
+  }
+}
+
+TEST(matchAllTest, Empty) {
+  fa::Automaton fa = createThirdFromEnd();
+  EXPECT_TRUE(fa.matchAll({}).empty());
+  EXPECT_TRUE(fa.matchAll({}, 4).empty());
+
+  // No initial state, nothing matches
+  fa::Automaton none = createAutomaton(2, {'a'});
+  EXPECT_EQ(none.matchAll({"", "a"}, 2), (std::vector<bool>{false, false}));
+}
+
+/***************************** */
+/*      AutomatonBuilder       */
+/***************************** */
+
+TEST(automatonBuilderTest, SameAsAddTransition) {
+  fa::Automaton fa = createThirdFromEnd();
+
+  fa::AutomatonBuilder builder;
+  std::vector<fa::AutomatonBuilder::Edge> edges;
+  for(const auto& t : fa.getTr()){
+    for(auto to : t.second){
+      edges.push_back({t.first.first, t.first.second, to});
+    }
+  }
+  // Unordered, with duplicates
+  std::reverse(edges.begin(), edges.end());
+  edges.push_back(edges.front());
+  EXPECT_TRUE(builder.addTransitions(edges));
+  EXPECT_EQ(builder.countEdges(), fa.countTransitions() + 1);
+  for(auto st : fa.getInitialSt()) builder.setStateInitial(st);
+  for(auto st : fa.getFinalSt()) builder.setStateFinal(st);
+
+  fa::Automaton built = builder.build();
+  EXPECT_EQ(built.getTr(), fa.getTr());
+  EXPECT_EQ(built.getSt(), fa.getSt());
+  EXPECT_EQ(built.getInitialSt(), fa.getInitialSt());
+  EXPECT_EQ(built.getFinalSt(), fa.getFinalSt());
+  EXPECT_EQ(std::set<char>(built.getAl()), std::set<char>(fa.getAl()));
+  EXPECT_EQ(builder.countEdges(), 0u);
+}
+
+TEST(automatonBuilderTest, RejectInvalid) {
+  fa::AutomatonBuilder builder;
+  EXPECT_FALSE(builder.addSymbol(' '));
+  EXPECT_FALSE(builder.addSymbol(fa::Epsilon));
+  EXPECT_TRUE(builder.addSymbol('z'));
+  EXPECT_FALSE(builder.addState(-1));
+  EXPECT_FALSE(builder.setStateInitial(-2));
+  EXPECT_FALSE(builder.addTransition(0, '\n', 1));
+  EXPECT_FALSE(builder.addTransition(-1, 'a', 1));
+  EXPECT_TRUE(builder.addTransition(0, fa::Epsilon, 1));
+  EXPECT_FALSE(builder.addTransitions({{0, 'a', 1}, {0, 'b', -1}}));
+  builder.setStateInitial(0);
+  builder.setStateFinal(1);
+
+  fa::Automaton fa = builder.build();
+  EXPECT_TRUE(fa.isValid());
+  EXPECT_EQ(fa.getSt(), (std::set<int>{0, 1}));
+  EXPECT_EQ(fa.countSymbols(), 2u); // 'a' and 'z'
+  EXPECT_EQ(fa.countTransitions(), 2u);
+  EXPECT_TRUE(fa.hasEpsilonTransition());
+  EXPECT_TRUE(fa.hasTransition(0, 'a', 1));
+}
+
+TEST(automatonBuilderTest, LargeChain) {
+  const int nb_states = 500000;
+  fa::AutomatonBuilder builder;
+  builder.reserve(2 * nb_states);
+  for(int st = nb_states - 1; st >= 0; --st){
+    builder.addTransition(st, 'a', st + 1);
+    builder.addTransition(st, 'b', 0);
+  }
+  builder.setStateInitial(0);
+  builder.setStateFinal(nb_states);
+
+  fa::Automaton fa = builder.build();
+  EXPECT_EQ(fa.countStates(), static_cast<std::size_t>(nb_states + 1));
+  EXPECT_EQ(fa.countTransitions(), static_cast<std::size_t>(2 * nb_states));
+  EXPECT_TRUE(fa.isDeterministic());
+  EXPECT_FALSE(fa.isLanguageEmpty());
+  EXPECT_TRUE(fa.hasTransition(nb_states - 1, 'a', nb_states));
+  EXPECT_TRUE(fa.hasTransition(nb_states - 1, 'b', 0));
+}
+
+/***************************** */
+/*    In place transformations */
+/***************************** */
+
+TEST(inPlaceTest, MakeComplete) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  fa::Automaton fa = createAutomaton(3, symbols);
+  fa.setPredecessorIndex(true);
+  fa.setStateInitial(0);
+  fa.setStateFinal(2);
+  fa.addTransition(0, 'a', 1);
+  fa.addTransition(1, 'b', 2);
+
+  fa.makeComplete();
+  EXPECT_TRUE(fa.isComplete());
+  EXPECT_TRUE(fa.isValid());
+  EXPECT_EQ(fa.countStates(), 4u);
+  EXPECT_EQ(fa.countTransitions(), 8u);
+  EXPECT_TRUE(fa.match("ab"));
+  EXPECT_FALSE(fa.match("abb"));
+
+  // The predecessor index follows the added transitions
+  fa.removeState(3);
+  EXPECT_EQ(fa.countTransitions(), 2u);
+}
+
+TEST(inPlaceTest, MakeMirror) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  for(bool indexed : {false, true}){
+    fa::Automaton fa = createAutomaton(3, symbols);
+    fa.setPredecessorIndex(indexed);
+    fa.setStateInitial(0);
+    fa.setStateFinal(2);
+    fa.addTransition(0, 'a', 1);
+    fa.addTransition(1, 'b', 2);
+    fa.addTransition(1, 'b', 1);
+
+    fa.makeMirror();
+    EXPECT_TRUE(fa.isValid());
+    EXPECT_EQ(fa.countTransitions(), 3u);
+    EXPECT_TRUE(fa.match("ba"));
+    EXPECT_TRUE(fa.match("bbba"));
+    EXPECT_FALSE(fa.match("ab"));
+    EXPECT_TRUE(fa.isStateInitial(2));
+    EXPECT_TRUE(fa.isStateFinal(0));
+  }
+}
+
+TEST(inPlaceTest, MakeComplement) {
+  fa::Automaton fa = createThirdFromEnd();
+  fa::Automaton complement = fa;
+  complement.makeComplement();
+
+  EXPECT_TRUE(complement.isDeterministic());
+  EXPECT_TRUE(complement.isComplete());
+  for(auto word : {"", "a", "ab", "abb", "babb", "bbbb", "aabab"}){
+    EXPECT_NE(fa.match(word), complement.match(word));
+  }
+}
+
+TEST(inPlaceTest, Trim) {
+  static const std::vector<char> symbols = {'a'};
+  fa::Automaton fa = createAutomaton(5, symbols);
+  fa.setStateInitial(0);
+  fa.setStateFinal(2);
+  fa.addTransition(0, 'a', 1);
+  fa.addTransition(1, 'a', 2);
+  fa.addTransition(0, 'a', 3); // not co-accessible
+  fa.addTransition(4, 'a', 2); // not accessible
+
+  fa.trim();
+  EXPECT_EQ(fa.getSt(), (std::set<int>{0, 1, 2}));
+  EXPECT_EQ(fa.countTransitions(), 2u);
+  EXPECT_TRUE(fa.match("aa"));
+}
+
+TEST(inPlaceTest, RvalueReusesStorage) {
+  static const std::vector<char> symbols = {'a', 'b'};
+  auto create = [](){
+    fa::Automaton fa = createAutomaton(2, symbols);
+    fa.setStateInitial(0);
+    fa.setStateFinal(1);
+    fa.addTransition(0, 'a', 1);
+    return fa;
+  };
+
+  fa::Automaton fa = create();
+  fa::Automaton copy = create();
+  const auto* transitions = &fa.getTr();
+  fa::Automaton complete = fa::Automaton::createComplete(std::move(fa));
+  EXPECT_EQ(&complete.getTr(), transitions);
+  EXPECT_TRUE(complete.isComplete());
+  // The const overload leaves its argument alone
+  fa::Automaton other = fa::Automaton::createComplete(copy);
+  EXPECT_FALSE(copy.isComplete());
+  EXPECT_EQ(other.countTransitions(), complete.countTransitions());
+
+  fa::Automaton mirror = fa::Automaton::createMirror(std::move(complete));
+  EXPECT_EQ(&mirror.getTr(), transitions);
+  EXPECT_TRUE(mirror.match("a"));
+
+  // A moved-from automaton is empty and usable
+  EXPECT_EQ(complete.countStates(), 0u);
+  EXPECT_TRUE(complete.addState(0));
+
+  fa::Automaton minimal = fa::Automaton::createMinimalMoore(std::move(copy));
+  EXPECT_TRUE(minimal.match("a"));
+  EXPECT_FALSE(minimal.match("ab"));
+  EXPECT_EQ(minimal.countStates(), 3u);
+}
+
 /***************************** */
 /*       TEST(Automaton)       */
 /***************************** */